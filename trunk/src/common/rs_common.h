@@ -40,6 +40,7 @@ The common value for rtmp server
 #include <string>
 #include <cassert>
 #include <memory>
+#include <functional>
 #include <cstdint>
 #include <cstdlib>
 #include <algorithm>
@@ -42,6 +42,12 @@ static const int ERROR_RTMP_PROTOCOL_C0C1_LENGTH_ERROR = 2002;
 static const int ERROR_RTMP_PROTOCOL_CHUNK_MESSAGE_FMT_ERROR = 2003;
 static const int ERROR_RTMP_PROTOCOL_AMF0_DECODE_ERROR = 2004;
 static const int ERROR_RTMP_PROTOCOL_FMT_BEYOND_LIMIT = 2005;
+static const int ERROR_RTMP_PROTOCOL_CHUNK_STREAM_NO_HEADER = 2006;
+static const int ERROR_RTMP_PROTOCOL_CHUNK_INTERRUPTED = 2007;
+static const int ERROR_RTMP_PROTOCOL_MESSAGE_TOO_LARGE = 2008;
+static const int ERROR_RTMP_PROTOCOL_CONTROL_MESSAGE_ERROR = 2009;
+static const int ERROR_RTMP_PROTOCOL_CHUNK_SIZE_INVALID = 2010;
+static const int ERROR_RTMP_PROTOCOL_COMMAND_ERROR = 2011;
 
 // error number for context
 static const int ERROR_CONTEXT_CONN_ID_EXISTS = 3000;
@@ -52,4 +58,14 @@ static const int ERROR_CONFIGURE_NO_SERVER_PARTS = 4001;
 static const int ERROR_CONFIGURE_SYNTAX_INVALID = 4002;
 static const int ERROR_CONFIGURE_TYPE_OF_SERVER_NOT_SUPPORT = 4003;
 
+// error number for kernel
+static const int ERROR_KERNEL_BUFFER_NOT_ENOUGH = 5000;
+static const int ERROR_KERNEL_IO_CLOSED = 5001;
+
+// error number for stream source
+static const int ERROR_SOURCE_STREAM_NOT_CREATED = 6000;
+
+// error number for server
+static const int ERROR_SERVER_WORKER_DETACHED = 7000;
+
 #endif
@@ -24,179 +24,116 @@ SOFTWARE.
 
 #include <rs_kernel_buffer.h>
 
-int RsBufferLittleEndian::write_1_byte(uint8_t val) {
-    int ret = ERROR_SUCCESS;
-
-    auto *p = (char *) &val;
-
-    buffer += p[0];
+// the initial size of the block, grows when needed
+#define RS_BUFFER_DEFAULT_CAPACITY 4096
 
-    return ret;
+RsBufferLittleEndian::RsBufferLittleEndian() : _read_pos(0), _write_pos(0) {
 }
 
-int RsBufferLittleEndian::write_2_byte(unsigned long val) {
-    int ret = ERROR_SUCCESS;
-
-    auto *pVal = (char *) &val;
-
-    buffer += pVal[1];
-    buffer += pVal[0];
-
-    return ret;
-}
+void RsBufferLittleEndian::ensure_writable(size_t size) {
+    if (_block.size() - _write_pos >= size) {
+        return;
+    }
 
-int RsBufferLittleEndian::write_3_byte(uint32_t val) {
-    int ret = ERROR_SUCCESS;
+    // move the unread bytes to the front to reuse the consumed space
+    size_t unread = length();
+    if (_read_pos > 0) {
+        if (unread > 0) {
+            memmove(_block.data(), _block.data() + _read_pos, unread);
+        }
+        _read_pos = 0;
+        _write_pos = unread;
+    }
 
-    auto *pVal = (char *) &val;
+    if (_block.size() - _write_pos >= size) {
+        return;
+    }
 
-    buffer += pVal[2];
-    buffer += pVal[1];
-    buffer += pVal[0];
+    size_t capacity = _block.empty() ? RS_BUFFER_DEFAULT_CAPACITY : _block.size();
+    while (capacity - _write_pos < size) {
+        capacity *= 2;
+    }
 
-    return ret;
+    _block.resize(capacity);
 }
 
-int RsBufferLittleEndian::write_4_byte(uint32_t val) {
-    int ret = ERROR_SUCCESS;
-
-    auto *pVal = (char *) &val;
-
-    buffer += pVal[3];
-    buffer += pVal[2];
-    buffer += pVal[1];
-    buffer += pVal[0];
-
-    return ret;
+void RsBufferLittleEndian::append(const char *buf, size_t size) {
+    ensure_writable(size);
+    memcpy(_block.data() + _write_pos, buf, size);
+    _write_pos += size;
 }
 
-int RsBufferLittleEndian::write_8_byte(uint64_t val) {
-    int ret = ERROR_SUCCESS;
+void RsBufferLittleEndian::consume(size_t size) {
+    assert(size <= length());
 
-    auto *pVal = (char *) &val;
+    _read_pos += size;
 
-    buffer += pVal[7];
-    buffer += pVal[6];
-    buffer += pVal[5];
-    buffer += pVal[4];
-    buffer += pVal[3];
-    buffer += pVal[2];
-    buffer += pVal[1];
-    buffer += pVal[0];
+    // all bytes are consumed, rewind for free
+    if (_read_pos == _write_pos) {
+        _read_pos = _write_pos = 0;
+    }
+}
 
-    return ret;
+int RsBufferLittleEndian::write_3_byte(uint32_t val) {
+    ensure_writable(3);
+    rs_write_be24(_block.data() + _write_pos, val);
+    _write_pos += 3;
+    return ERROR_SUCCESS;
 }
 
 int RsBufferLittleEndian::write_bytes(std::string buf) {
-    buffer.append(buf);
+    append(buf.data(), buf.size());
     return ERROR_SUCCESS;
 }
 
 int RsBufferLittleEndian::write_bytes(const char *buf, int size) {
     int ret = ERROR_SUCCESS;
 
-    buffer += std::string(buf, (unsigned long) size);
+    append(buf, (size_t) size);
 
     return ret;
 }
 
-uint8_t RsBufferLittleEndian::read_1_byte() {
-    uint8_t val = 0;
-
-    val = static_cast<uint8_t>(buffer[0]);
-
-    buffer.erase(buffer.begin());
-
+uint32_t RsBufferLittleEndian::read_3_byte() {
+    assert(length() >= 3);
+    uint32_t val = rs_read_be24(_block.data() + _read_pos);
+    consume(3);
     return val;
 }
 
-uint16_t RsBufferLittleEndian::read_2_byte() {
-    uint16_t val = 0;
-
-    auto *pVal = (char *) &val;
-
-    for (int i = 1; i >= 0; --i) {
-        pVal[i] = buffer.at(0);
-        buffer.erase(buffer.begin());
-    }
-
-    return val;
+std::string RsBufferLittleEndian::read_bytes(int size) {
+    size_t n = std::min((size_t) size, length());
+    std::string buf(_block.data() + _read_pos, n);
+    consume(n);
+    return buf;
 }
 
-uint32_t RsBufferLittleEndian::read_3_byte() {
-    uint32_t val = 0;
-
-    auto *pVal = (char *) &val;
+int RsBufferLittleEndian::read(RsSlice &slice, int size) {
+    int ret = ERROR_SUCCESS;
 
-    for (int i = 2; i >= 0; --i) {
-        pVal[i] = buffer.at(0);
-        buffer.erase(buffer.begin());
+    if ((ret = peek(slice, size)) != ERROR_SUCCESS) {
+        return ret;
     }
 
-    return val;
-}
-
-uint32_t RsBufferLittleEndian::read_4_byte() {
-    uint32_t val = 0;
+    consume(slice.size);
 
-    auto *pVal = (char *) &val;
-
-    for (int i = 3; i >= 0; --i) {
-        pVal[i] = buffer.at(0);
-        buffer.erase(buffer.begin());
-    }
-
-    return val;
+    return ret;
 }
 
-uint64_t RsBufferLittleEndian::read_8_byte() {
-    uint64_t val = 0;
-
-    auto *pVal = (char *) &val;
-
-    for (int i = 7; i >= 0; --i) {
-        pVal[i] = buffer.at(0);
-        buffer.erase(buffer.begin());
+int RsBufferLittleEndian::peek(RsSlice &slice, int size) {
+    if (size < 0 || length() < (size_t) size) {
+        return ERROR_KERNEL_BUFFER_NOT_ENOUGH;
     }
 
-    return val;
-}
+    slice = RsSlice(_block.data() + _read_pos, (size_t) size);
 
-std::string RsBufferLittleEndian::read_bytes(int size) {
-    std::string buf;
-    buf = buffer.substr(0, size);
-    buffer.erase(0, size);
-    return buf;
+    return ERROR_SUCCESS;
 }
 
 std::string RsBufferLittleEndian::dump() {
-    if (!buffer.empty()) {
-        return buffer;
+    if (length() > 0) {
+        return std::string(_block.data() + _read_pos, length());
     }
 
     return "";
 }
-
-uint16_t RsBufferLittleEndian::convert_2bytes_into_uint16(std::string buf) {
-    RsBufferLittleEndian rs_buf;
-    rs_buf.write_bytes(buf.c_str(), 2);
-    return rs_buf.read_2_byte();
-}
-
-uint32_t RsBufferLittleEndian::convert_3bytes_into_uint32(std::string buf) {
-    RsBufferLittleEndian rs_buf;
-    rs_buf.write_bytes(buf.c_str(), 3);
-    return rs_buf.read_3_byte();
-}
-
-uint32_t RsBufferLittleEndian::convert_4bytes_into_uint32(std::string buf) {
-    RsBufferLittleEndian rs_buf;
-    rs_buf.write_bytes(buf.c_str(), 4);
-    return rs_buf.read_4_byte();
-}
-
-uint64_t RsBufferLittleEndian::convert_8bytes_into_uint64(std::string buf) {
-    RsBufferLittleEndian rs_buf;
-    rs_buf.write_bytes(buf.c_str(), 8);
-    return rs_buf.read_8_byte();
-}
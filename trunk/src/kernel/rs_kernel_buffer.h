@@ -26,51 +26,162 @@ SOFTWARE.
 #define RS_KERNEL_BUFFER_HEADER_H_
 
 
+#include <cstring>
 #include "rs_common.h"
 #include "rs_kernel_io.h"
 
+/**
+ * big endian codec for the network byte order, each one is an unaligned
+ * load/store plus a byte swap on little endian hosts.
+ */
+inline uint8_t rs_bswap(uint8_t val) { return val; }
+
+inline uint16_t rs_bswap(uint16_t val) { return __builtin_bswap16(val); }
+
+inline uint32_t rs_bswap(uint32_t val) { return __builtin_bswap32(val); }
+
+inline uint64_t rs_bswap(uint64_t val) { return __builtin_bswap64(val); }
+
+template<typename T>
+inline T rs_read_be(const char *p) {
+    T val;
+    memcpy(&val, p, sizeof(T));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    val = rs_bswap(val);
+#endif
+    return val;
+}
+
+template<typename T>
+inline void rs_write_be(char *p, T val) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    val = rs_bswap(val);
+#endif
+    memcpy(p, &val, sizeof(T));
+}
+
+// amf0 numbers are the big endian bits of an ieee-754 double
+template<>
+inline double rs_read_be<double>(const char *p) {
+    uint64_t bits = rs_read_be<uint64_t>(p);
+    double val;
+    memcpy(&val, &bits, sizeof(val));
+    return val;
+}
+
+template<>
+inline void rs_write_be<double>(char *p, double val) {
+    uint64_t bits;
+    memcpy(&bits, &val, sizeof(bits));
+    rs_write_be<uint64_t>(p, bits);
+}
+
+// 24 bits timestamp and length in rtmp chunk header
+inline uint32_t rs_read_be24(const char *p) {
+    auto u = (const uint8_t *) p;
+    return (uint32_t(u[0]) << 16) | (uint32_t(u[1]) << 8) | uint32_t(u[2]);
+}
+
+inline void rs_write_be24(char *p, uint32_t val) {
+    uint32_t be = val << 8;
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    be = rs_bswap(be);
+#endif
+    memcpy(p, &be, 3);
+}
+
+// the message stream id is the only little endian field of rtmp
+inline uint32_t rs_read_le32(const char *p) {
+    uint32_t val;
+    memcpy(&val, p, sizeof(val));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    val = rs_bswap(val);
+#endif
+    return val;
+}
+
+inline void rs_write_le32(char *p, uint32_t val) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    val = rs_bswap(val);
+#endif
+    memcpy(p, &val, sizeof(val));
+}
+
 // little endian
+/**
+ * byte buffer with a read cursor and a write cursor over one reusable block.
+ * reads only move the read cursor, the unread bytes are moved to the front
+ * lazily when the tail has no room for a write.
+ */
 class RsBufferLittleEndian : public IRsReaderWriter {
 private:
-    std::string buffer;
+    std::vector<char> _block;
+    size_t _read_pos;
+    size_t _write_pos;
 public:
-    RsBufferLittleEndian() = default;
+    RsBufferLittleEndian();
 
     ~RsBufferLittleEndian() override = default;
 
+private:
+    // make sure there are at least size bytes writable after the write cursor
+    void ensure_writable(size_t size);
+
+    void append(const char *buf, size_t size);
+
+    void consume(size_t size);
+
 public:
-    int write_1_byte(uint8_t val);
+    template<typename T>
+    int write(T val) {
+        ensure_writable(sizeof(T));
+        rs_write_be<T>(_block.data() + _write_pos, val);
+        _write_pos += sizeof(T);
+        return ERROR_SUCCESS;
+    }
+
+    template<typename T>
+    T read() {
+        assert(length() >= sizeof(T));
+        T val = rs_read_be<T>(_block.data() + _read_pos);
+        consume(sizeof(T));
+        return val;
+    }
 
-    int write_2_byte(unsigned long val);
+    int write_1_byte(uint8_t val) { return write<uint8_t>(val); }
+
+    int write_2_byte(unsigned long val) { return write<uint16_t>((uint16_t) val); }
 
     int write_3_byte(uint32_t val);
 
-    int write_4_byte(uint32_t val);
+    int write_4_byte(uint32_t val) { return write<uint32_t>(val); }
 
-    int write_8_byte(uint64_t val);
+    int write_8_byte(uint64_t val) { return write<uint64_t>(val); }
 
     int write_bytes(std::string buf);
 
     int write_bytes(const char *buf, int size);
 
-    int write(std::string buf, int size) override { return write_bytes(buf.c_str(), size); }
+    using IRsReaderWriter::read;
+    using IRsReaderWriter::write;
+
+    int write(const char *buf, int size) override { return write_bytes(buf, size); }
 
-    uint8_t read_1_byte();
+    uint8_t read_1_byte() { return read<uint8_t>(); }
 
-    uint16_t read_2_byte();
+    uint16_t read_2_byte() { return read<uint16_t>(); }
 
     uint32_t read_3_byte();
 
-    uint32_t read_4_byte();
+    uint32_t read_4_byte() { return read<uint32_t>(); }
 
-    uint64_t read_8_byte();
+    uint64_t read_8_byte() { return read<uint64_t>(); }
 
     std::string read_bytes(int size);
 
-    int read(std::string &buf, int size) override {
-        buf = read_bytes(size);
-        return ERROR_SUCCESS;
-    }
+    int read(RsSlice &slice, int size) override;
+
+    int peek(RsSlice &slice, int size) override;
 
     int start_read(read_cb, void *param) override {
         return ERROR_SUCCESS;
@@ -78,18 +189,20 @@ public:
 
     std::string dump();
 
-    size_t length() { return buffer.size(); }
+    size_t length() { return _write_pos - _read_pos; }
+
+    size_t capacity() { return _block.size(); }
 
-    void clear() { buffer.clear(); };
+    void clear() { _read_pos = _write_pos = 0; };
 
 public:
-    static uint16_t convert_2bytes_into_uint16(std::string buf);
+    static uint16_t convert_2bytes_into_uint16(const char *buf) { return rs_read_be<uint16_t>(buf); }
 
-    static uint32_t convert_3bytes_into_uint32(std::string buf);
+    static uint32_t convert_3bytes_into_uint32(const char *buf) { return rs_read_be24(buf); }
 
-    static uint32_t convert_4bytes_into_uint32(std::string buf);
+    static uint32_t convert_4bytes_into_uint32(const char *buf) { return rs_read_be<uint32_t>(buf); }
 
-    static uint64_t convert_8bytes_into_uint64(std::string buf);
+    static uint64_t convert_8bytes_into_uint64(const char *buf) { return rs_read_be<uint64_t>(buf); }
 };
 
 #endif
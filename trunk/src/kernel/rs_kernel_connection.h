@@ -25,6 +25,14 @@ SOFTWARE.
 #ifndef RS_KERNEL_CONNECTION_HEADER_H_
 #define RS_KERNEL_CONNECTION_HEADER_H_
 
+#include <functional>
+
+class IRsIO;
+
+class RsConnection;
+
+using connection_stopped_cb = std::function<void(RsConnection *conn, void *param)>;
+
 class RsConnection {
 protected:
     typedef enum {
@@ -36,8 +44,15 @@ protected:
 private:
     RS_CONNECTION_STATUS _connection_status;
 
+    connection_stopped_cb _stopped_cb;
+    void *_stopped_param;
+
+    // position of the connection in its owner
+    size_t _slot;
+
 public:
-    RsConnection() : _connection_status(rs_connection_uninitialized) {};
+    RsConnection() : _connection_status(rs_connection_uninitialized), _stopped_param(nullptr),
+                     _slot(0) {};
 
     virtual ~RsConnection() { _connection_status = rs_connection_stopped; };
 
@@ -52,11 +67,30 @@ public:
 
     bool is_stopped() { return _connection_status == rs_connection_stopped; }
 
+    // the owner is told once the connection stopped, and may free it in the callback
+    void set_stopped_cb(connection_stopped_cb cb, void *param) {
+        _stopped_cb = std::move(cb);
+        _stopped_param = param;
+    }
+
+    void set_slot(size_t slot) { _slot = slot; }
+
+    size_t get_slot() { return _slot; }
+
+protected:
+    // must be the last thing done by the connection, which may be gone after it
+    void notify_stopped() {
+        change_connection_status(rs_connection_stopped);
+
+        auto cb = _stopped_cb;
+        if (cb) {
+            cb(this, _stopped_param);
+        }
+    }
+
 public:
 
     virtual int initialize(IRsIO *io) = 0;
-
-    virtual void update_status() = 0;
 };
 
 #endif
\ No newline at end of file
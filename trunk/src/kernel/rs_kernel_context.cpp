@@ -22,12 +22,24 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
 
+#include <atomic>
 #include "rs_kernel_io.h"
 #include "rs_kernel_context.h"
 
-RsConnContext::RsConnContext() {
+// ids one thread can take before running into the range of the next one
+static const uint64_t RS_CONTEXT_IDS_PER_THREAD = 1000000;
+
+RsConnContext::RsConnContext() : RsConnContext(200) {
+}
+
+RsConnContext::RsConnContext(uint64_t first_id) {
     DEFAULT_ID = 100;
-    current_ID = 200;
+    current_ID = first_id;
+}
+
+uint64_t RsConnContext::next_first_id() {
+    static std::atomic<uint64_t> first_id(200);
+    return first_id.fetch_add(RS_CONTEXT_IDS_PER_THREAD);
 }
 
 RsConnContext::~RsConnContext() {
@@ -38,6 +38,8 @@ private:
 public:
     RsConnContext();
 
+    explicit RsConnContext(uint64_t first_id);
+
     RsConnContext(RsConnContext const &) = delete;
 
     RsConnContext(RsConnContext &&) = delete;
@@ -53,8 +55,14 @@ public:
 
     uint64_t get_id(IRsIO *io);
 
+private:
+    static uint64_t next_first_id();
+
+public:
+    // one context per thread, each thread takes its own range of ids
     static std::shared_ptr<RsConnContext> getInstance() {
-        static auto ins = std::shared_ptr<RsConnContext>(new RsConnContext());
+        static thread_local auto ins = std::shared_ptr<RsConnContext>(
+                new RsConnContext(next_first_id()));
         return ins;
     };
 };
@@ -24,13 +24,36 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
 
+#include <cerrno>
+#include <sys/socket.h>
+#include <unistd.h>
 #include "rs_module_log.h"
 #include "rs_kernel_io.h"
 #include "rs_kernel_context.h"
+#include "rs_kernel_loop.h"
 
-#define MESSAGE_BUFFER_LENGTH 4096
+struct RsWriteBatch {
+    uv_write_t req;
+    // null once the connection is gone
+    RsTCPSocketIO *io;
+    std::vector<RsSharedSlice> slices;
+};
+
+int IRsReaderWriter::read(std::string &buf, int size) {
+    int ret = ERROR_SUCCESS;
+
+    RsSlice slice;
+    if ((ret = read(slice, size)) != ERROR_SUCCESS) {
+        return ret;
+    }
+
+    buf.assign(slice.data, slice.size);
+
+    return ret;
+}
 
 RsTCPListener::RsTCPListener() {
+    _handle_initialized = false;
     _extra_param = nullptr;
 
     RsConnContext::getInstance()->do_register(this);
@@ -54,25 +77,45 @@ void RsTCPListener::on_connection(uv_stream_t *s, int status) {
     auto io = new RsTCPSocketIO();
     if ((ret = io->initialize(s)) != ERROR_SUCCESS) {
         rs_error(pt_this, "accept one connection for tcp failed. ret=%d", ret);
+        rs_free_p(io);
         return;
     }
 
     pt_this->_on_conn_cb(io, pt_this->_extra_param);
 }
 
-int RsTCPListener::initialize(std::string ip, int port, on_new_connection_cb cb, void *param) {
+int RsTCPListener::initialize(std::string ip, int port, on_new_connection_cb cb, void *param,
+                              bool reuse_port) {
     int ret = ERROR_SUCCESS;
 
     _on_conn_cb = cb;
     _extra_param = param;
 
-    if ((ret = uv_tcp_init(uv_default_loop(), &_listen_sock)) != ERROR_SUCCESS) {
+    // the socket is created now rather than at bind, so the option can be set before
+    if ((ret = uv_tcp_init_ex(RsLoop::get_instance()->get_uv_loop(), &_listen_sock, AF_INET)) !=
+        ERROR_SUCCESS) {
         rs_error(this, "create socket using libuv failed. ret=%d", ret);
         return ret;
     }
 
+    _handle_initialized = true;
     _listen_sock.data = this;
 
+    if (reuse_port) {
+        uv_os_fd_t fd;
+        if ((ret = uv_fileno((uv_handle_t *) &_listen_sock, &fd)) != ERROR_SUCCESS) {
+            rs_error(this, "get fd of listener failed. ret=%d", ret);
+            return ret;
+        }
+
+        int on = 1;
+        if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) != 0) {
+            ret = -errno;
+            rs_error(this, "set SO_REUSEPORT failed. ret=%d", ret);
+            return ret;
+        }
+    }
+
     struct sockaddr_in addr{};
     if ((ret = uv_ip4_addr(ip.c_str(), port, &addr)) != ERROR_SUCCESS) {
         rs_error(this, "initialize the ip4 address failed. ret=%d", ret);
@@ -96,23 +139,14 @@ int RsTCPListener::initialize(std::string ip, int port, on_new_connection_cb cb,
 }
 
 void RsTCPListener::close() {
-    uv_shutdown_t uv_shutdown_req;
-    uv_shutdown_req.data = this;
-
-    int ret = ERROR_SUCCESS;
-
     change_status(rs_io_close);
 
-    auto shutdown_cb = [](uv_shutdown_t *req, int status) {
-        auto io = (RsTCPListener *) req->data;
-        rs_info(io, "do shutdown!");
-    };
-
-    if ((ret = uv_shutdown(&uv_shutdown_req, (uv_stream_t *) &_listen_sock, shutdown_cb)) != 0) {
-        rs_error(this, "shutdown tcp listener failed. ret=%d", ret);
+    if (!_handle_initialized || uv_is_closing((uv_handle_t *) &_listen_sock)) {
         return;
     }
 
+    // the handle is a member, so the owner must keep the listener until the
+    // loop has run the close, see RsServerWorker
     auto close_cb = [](uv_handle_t *handle) {
         rs_info(nullptr, "uv close handle function");
     };
@@ -121,39 +155,131 @@ void RsTCPListener::close() {
 }
 
 RsTCPSocketIO::RsTCPSocketIO() {
-    _base.reserve(MESSAGE_BUFFER_LENGTH);
-    _uv_tcp_socket = new uv_tcp_t();
+    _loop = RsLoop::get_instance();
+    _uv_tcp_socket = _loop->get_pool<uv_tcp_t>().allocate();
+    _handle_initialized = false;
+    _flush_scheduled = false;
+    _inflight = nullptr;
+    _pending_bytes = 0;
+    _high_watermark = 0;
+    _low_watermark = 0;
+    _writable = true;
+    _drain_param = nullptr;
+    _close_param = nullptr;
     _extra_data = nullptr;
 
     RsConnContext::getInstance()->do_register(this);
 }
 
 RsTCPSocketIO::~RsTCPSocketIO() {
-    rs_free_p(_uv_tcp_socket);
+    if (_flush_scheduled) {
+        _loop->cancel_check(this);
+    }
+
+    // libuv cancels the write when closing, the batch is released then
+    if (_inflight != nullptr) {
+        _inflight->io = nullptr;
+    }
+
+    if (_uv_tcp_socket != nullptr) {
+        if (!_handle_initialized) {
+            _loop->get_pool<uv_tcp_t>().release(_uv_tcp_socket);
+        } else {
+            // the handle goes back to the pool once libuv has closed it
+            _uv_tcp_socket->data = nullptr;
+            if (!uv_is_closing((uv_handle_t *) _uv_tcp_socket)) {
+                uv_close((uv_handle_t *) _uv_tcp_socket, on_close);
+            }
+        }
+    }
 
     RsConnContext::getInstance()->do_deregister(this);
 }
 
+void RsTCPSocketIO::on_close(uv_handle_t *handle) {
+    auto io = (RsTCPSocketIO *) handle->data;
+
+    RsLoop::from(handle->loop)->get_pool<uv_tcp_t>().release((uv_tcp_t *) handle);
+
+    if (io == nullptr) {
+        return;
+    }
+
+    io->_uv_tcp_socket = nullptr;
+
+    // the owner may free the io in the callback
+    auto cb = io->_close_cb;
+    if (cb) {
+        cb(io->_close_param);
+    }
+}
+
 int RsTCPSocketIO::initialize(uv_stream_t *stream) {
     int ret = ERROR_SUCCESS;
 
-    if ((ret = uv_tcp_init(uv_default_loop(), _uv_tcp_socket)) != ERROR_SUCCESS) {
+    if ((ret = uv_tcp_init(stream->loop, _uv_tcp_socket)) != ERROR_SUCCESS) {
         rs_error(nullptr, "initialize the client socket from loop failed. ret=%d", ret);
         return ret;
     }
 
+    _handle_initialized = true;
+    _uv_tcp_socket->data = this;
+    _loop = RsLoop::from(_uv_tcp_socket->loop);
+
     if ((ret = uv_accept(stream, (uv_stream_t *) _uv_tcp_socket)) != ERROR_SUCCESS) {
         rs_error(nullptr, "accept one connection failed. ret=%d", ret);
         return ret;
     }
 
+    change_status(rs_io_open);
+    rs_info(this, "ready to read message");
+    return ret;
+}
+
+int RsTCPSocketIO::initialize(uv_os_sock_t fd) {
+    int ret = ERROR_SUCCESS;
+
+    if ((ret = uv_tcp_init(RsLoop::get_instance()->get_uv_loop(), _uv_tcp_socket)) !=
+        ERROR_SUCCESS) {
+        rs_error(nullptr, "initialize the client socket from loop failed. ret=%d", ret);
+        return ret;
+    }
+
+    _handle_initialized = true;
     _uv_tcp_socket->data = this;
+    _loop = RsLoop::from(_uv_tcp_socket->loop);
+
+    if ((ret = uv_tcp_open(_uv_tcp_socket, fd)) != ERROR_SUCCESS) {
+        rs_error(nullptr, "open one dispatched connection failed. ret=%d", ret);
+        return ret;
+    }
 
     change_status(rs_io_open);
     rs_info(this, "ready to read message");
     return ret;
 }
 
+int RsTCPSocketIO::detach(uv_os_sock_t &fd) {
+    int ret = ERROR_SUCCESS;
+
+    uv_os_fd_t current;
+    if ((ret = uv_fileno((uv_handle_t *) _uv_tcp_socket, &current)) != ERROR_SUCCESS) {
+        rs_error(this, "get fd of connection failed. ret=%d", ret);
+        return ret;
+    }
+
+    // libuv closes its own fd with the handle
+    if ((fd = dup(current)) < 0) {
+        ret = -errno;
+        rs_error(this, "duplicate fd of connection failed. ret=%d", ret);
+        return ret;
+    }
+
+    close();
+
+    return ret;
+}
+
 int RsTCPSocketIO::start_read(read_cb cb, void *param) {
     int ret = ERROR_SUCCESS;
 
@@ -163,11 +289,12 @@ int RsTCPSocketIO::start_read(read_cb cb, void *param) {
     _extra_data = param;
 
     // start to read
+    // the read block is only held while libuv reads into it
     auto alloc_cb = [](uv_handle_t *handle,
                        size_t suggested_size,
                        uv_buf_t *buf) {
-        auto io = (RsTCPSocketIO *) handle->data;
-        *buf = uv_buf_init(io->_base.data(), MESSAGE_BUFFER_LENGTH);
+        auto block = RsLoop::from(handle->loop)->get_pool<RsReadBlock>().allocate();
+        *buf = uv_buf_init(block->data, RS_READ_BLOCK_SIZE);
     };
 
     auto read_cb = [](uv_stream_t *stream,
@@ -175,13 +302,16 @@ int RsTCPSocketIO::start_read(read_cb cb, void *param) {
                       const uv_buf_t *buf) {
         auto io = (RsTCPSocketIO *) stream->data;
 
-        if (num_read <= 0) {
+        if (num_read > 0) {
+            io->_read_cb(buf->base, num_read, io->_extra_data);
+        } else if (num_read < 0) {
             io->close();
-            return;
         }
 
-        io->_read_cb(buf->base, num_read, io->_extra_data);
-
+        if (buf->base != nullptr) {
+            RsLoop::from(stream->loop)->get_pool<RsReadBlock>().release(
+                    (RsReadBlock *) buf->base);
+        }
     };
 
     if ((ret = uv_read_start((uv_stream_t *) _uv_tcp_socket, alloc_cb, read_cb)) !=
@@ -193,34 +323,174 @@ int RsTCPSocketIO::start_read(read_cb cb, void *param) {
     return ret;
 }
 
-int RsTCPSocketIO::write(std::string buf, int size) {
+int RsTCPSocketIO::write(const char *buf, int size) {
+    return write(RsSharedSlice::copy_from(buf, (size_t) size));
+}
+
+int RsTCPSocketIO::write(const RsSharedSlice &slice) {
     int ret = ERROR_SUCCESS;
 
-    assert(buf.size() >= size);
+    if (_uv_tcp_socket == nullptr || !is_open()) {
+        ret = ERROR_KERNEL_IO_CLOSED;
+        return ret;
+    }
 
-    auto write_cb = [](uv_write_t *req, int status) {
-        if (status == UV_EINVAL) {
-            rs_error(nullptr, "invalid");
+    if (slice.empty()) {
+        return ret;
+    }
+
+    _pending.push_back(slice);
+    _pending_bytes += slice.size();
+    update_writable();
+    schedule_flush();
+
+    return ret;
+}
+
+void RsTCPSocketIO::set_watermarks(size_t high, size_t low) {
+    assert(high == 0 || low <= high);
+
+    _high_watermark = high;
+    _low_watermark = low;
+}
+
+void RsTCPSocketIO::set_drain_cb(drain_cb cb, void *param) {
+    _drain_cb = cb;
+    _drain_param = param;
+}
+
+void RsTCPSocketIO::set_close_cb(close_cb cb, void *param) {
+    _close_cb = std::move(cb);
+    _close_param = param;
+}
+
+size_t RsTCPSocketIO::get_queued_bytes() {
+    size_t queued = _pending_bytes;
+
+    // libuv counts what is left of the write in flight
+    if (_uv_tcp_socket != nullptr) {
+        queued += _uv_tcp_socket->write_queue_size;
+    }
+
+    return queued;
+}
+
+void RsTCPSocketIO::update_writable() {
+    if (_high_watermark == 0) {
+        return;
+    }
+
+    size_t queued = get_queued_bytes();
+
+    if (_writable && queued >= _high_watermark) {
+        _writable = false;
+        rs_warn(this, "not writable, queued=%d, high watermark=%d", (int) queued,
+                (int) _high_watermark);
+        return;
+    }
+
+    if (!_writable && queued <= _low_watermark) {
+        _writable = true;
+        rs_info(this, "drained, queued=%d, low watermark=%d", (int) queued,
+                (int) _low_watermark);
+
+        if (_drain_cb != nullptr) {
+            _drain_cb(_drain_param);
         }
+    }
+}
 
-        rs_info(nullptr, "write finished, status=%d", status);
-    };
+void RsTCPSocketIO::on_loop_check() {
+    int ret = ERROR_SUCCESS;
 
-    uv_write_t *write_req = new uv_write_t();
-    uv_buf_t test_buf = {(char *) buf.c_str(), (size_t) size};
+    _flush_scheduled = false;
 
-    if ((ret = uv_write(write_req, (uv_stream_t *) _uv_tcp_socket, &test_buf, 1,
-                        write_cb)) !=
-        ERROR_SUCCESS) {
+    if ((ret = flush()) != ERROR_SUCCESS) {
+        rs_error(this, "flush the write queue failed. ret=%d", ret);
+        close();
+    }
+}
+
+void RsTCPSocketIO::schedule_flush() {
+    if (_flush_scheduled) {
+        return;
+    }
+
+    _flush_scheduled = true;
+    _loop->schedule_check(this);
+}
+
+int RsTCPSocketIO::flush() {
+    int ret = ERROR_SUCCESS;
+
+    // the next batch is sent when the one in flight is done
+    if (_inflight != nullptr || _pending.empty()) {
+        return ret;
+    }
+
+    if (_uv_tcp_socket == nullptr || !is_open()) {
+        _pending.clear();
+        _pending_bytes = 0;
+        return ret;
+    }
+
+    auto batch = RsLoop::from(_uv_tcp_socket->loop)->get_pool<RsWriteBatch>().allocate();
+    batch->req.data = batch;
+    batch->io = this;
+    batch->slices.swap(_pending);
+    _pending_bytes = 0;
+
+    _bufs.clear();
+    for (auto &slice : batch->slices) {
+        _bufs.push_back(uv_buf_init((char *) slice.data(), (unsigned int) slice.size()));
+    }
+
+    // libuv copies the uv_buf_t array, the slices are kept by the batch
+    if ((ret = uv_write(&batch->req, (uv_stream_t *) _uv_tcp_socket, _bufs.data(),
+                        (unsigned int) _bufs.size(), on_written)) != ERROR_SUCCESS) {
         rs_error(this, "write failed. ret=%d", ret);
+        RsLoop::from(_uv_tcp_socket->loop)->get_pool<RsWriteBatch>().release(batch);
         return ret;
     }
 
+    _inflight = batch;
+
     return ret;
 }
 
+void RsTCPSocketIO::on_written(uv_write_t *req, int status) {
+    auto batch = (RsWriteBatch *) req->data;
+    auto io = batch->io;
+
+    RsLoop::from(req->handle->loop)->get_pool<RsWriteBatch>().release(batch);
+
+    if (io == nullptr) {
+        return;
+    }
+
+    io->_inflight = nullptr;
+
+    if (status != 0) {
+        if (status != UV_ECANCELED) {
+            rs_error(io, "write finished with error, status=%d", status);
+            io->close();
+        }
+        return;
+    }
+
+    if (!io->_pending.empty()) {
+        io->schedule_flush();
+    }
+
+    io->update_writable();
+}
+
 void RsTCPSocketIO::close() {
+    if (_uv_tcp_socket == nullptr || uv_is_closing((uv_handle_t *) _uv_tcp_socket)) {
+        return;
+    }
+
     change_status(rs_io_close);
     rs_info(this, "do close one tcp connection");
-    uv_close((uv_handle_t *) _uv_tcp_socket, NULL);
+    uv_close((uv_handle_t *) _uv_tcp_socket, on_close);
 }
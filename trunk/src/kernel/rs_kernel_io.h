@@ -28,6 +28,8 @@ SOFTWARE.
 #include <uv.h>
 #include "rs_common.h"
 #include "rs_kernel_context.h"
+#include "rs_kernel_slice.h"
+#include "rs_kernel_loop.h"
 
 class IRsIO {
 protected:
@@ -59,6 +61,10 @@ public:
 
 using read_cb = std::function<void(char *buf, ssize_t size, void *param)>;
 
+using drain_cb = std::function<void(void *param)>;
+
+using close_cb = std::function<void(void *param)>;
+
 class IRsReaderWriter : public IRsIO {
 public:
     IRsReaderWriter() = default;
@@ -66,11 +72,25 @@ public:
     virtual ~IRsReaderWriter() = default;
 
 public:
-    virtual int write(std::string buf, int size) = 0;
+    virtual int write(const char *buf, int size) = 0;
+
+    // the slice is referenced rather than copied when the writer can keep it
+    virtual int write(const RsSharedSlice &slice) {
+        return write(slice.data(), static_cast<int>(slice.size()));
+    }
 
-    virtual int read(std::string &buf, int size) = 0;
+    // consume size bytes, the slice points into the reader and is valid until next write
+    virtual int read(RsSlice &slice, int size) = 0;
+
+    // same as read, but the bytes are not consumed
+    virtual int peek(RsSlice &slice, int size) = 0;
 
     virtual int start_read(read_cb, void *param) = 0;
+
+public:
+    int write(const std::string &buf, int size) { return write(buf.data(), size); }
+
+    int read(std::string &buf, int size);
 };
 
 using on_new_connection_cb = std::function<void(IRsReaderWriter *, void *)>;
@@ -78,6 +98,7 @@ using on_new_connection_cb = std::function<void(IRsReaderWriter *, void *)>;
 class RsTCPListener : public IRsIO {
 private:
     uv_tcp_t _listen_sock{};
+    bool _handle_initialized;
     void *_extra_param;
     on_new_connection_cb _on_conn_cb;
 public:
@@ -89,18 +110,49 @@ private:
     static void on_connection(uv_stream_t *s, int status);
 
 public:
-    int initialize(std::string ip, int port, on_new_connection_cb, void *param);
+    /**
+     * listen on the loop of current thread. with reuse_port, every loop can bind
+     * its own listener to the same port, and the kernel spreads the connections.
+     */
+    int initialize(std::string ip, int port, on_new_connection_cb, void *param,
+                   bool reuse_port = false);
 
-private:
     void close();
 };
 
 
-class RsTCPSocketIO : public IRsReaderWriter {
+struct RsWriteBatch;
+
+/**
+ * tcp connection, the writes are queued and sent by one uv_write with all
+ * the queued slices at the end of the loop iteration, only one uv_write is
+ * in flight at a time.
+ */
+class RsTCPSocketIO : public IRsReaderWriter, public IRsLoopCheck {
 public:
+    // the loop of the socket, where it is allocated until opened on another one
+    RsLoop *_loop;
+    // from the pool of the loop, released after libuv closed it
     uv_tcp_t *_uv_tcp_socket;
-    std::vector<char> _base;
-    std::string buffer;
+    bool _handle_initialized;
+
+    // slices written but not handed to libuv yet
+    std::vector<RsSharedSlice> _pending;
+    bool _flush_scheduled;
+    // the uv_write in flight, owns the slices until the write callback
+    RsWriteBatch *_inflight;
+    std::vector<uv_buf_t> _bufs;
+
+    // backpressure, not writable from high watermark until drained to low watermark
+    size_t _pending_bytes;
+    size_t _high_watermark;
+    size_t _low_watermark;
+    bool _writable;
+    drain_cb _drain_cb;
+    void *_drain_param;
+
+    close_cb _close_cb;
+    void *_close_param;
 
     void *_extra_data;
     read_cb _read_cb;
@@ -112,16 +164,62 @@ public:
 public:
     int initialize(uv_stream_t *stream);
 
+    // open a socket accepted by another loop on the loop of current thread, the
+    // caller still owns the socket when failed
+    int initialize(uv_os_sock_t fd);
+
+    // take a duplicate of the socket for another loop, this io is closed then
+    int detach(uv_os_sock_t &fd);
+
 // implement IRsReaderWrite
 public:
     int start_read(read_cb, void *param) override;
 
-    int read(std::string &buf, int size) override { return ERROR_SUCCESS; }
+    using IRsReaderWriter::read;
+    using IRsReaderWriter::write;
 
-    int write(std::string buf, int size) override;
+    int read(RsSlice &slice, int size) override { return ERROR_SUCCESS; }
 
-private:
+    int peek(RsSlice &slice, int size) override { return ERROR_SUCCESS; }
+
+    int write(const char *buf, int size) override;
+
+    int write(const RsSharedSlice &slice) override;
+
+public:
+    // 0 for high watermark means no limit
+    void set_watermarks(size_t high, size_t low);
+
+    // called when the queued bytes drop to the low watermark after being not writable
+    void set_drain_cb(drain_cb cb, void *param);
+
+    // called once libuv closed the socket, the io may be freed in the callback
+    void set_close_cb(close_cb cb, void *param);
+
+    // the bytes queued by write and not sent to kernel yet
+    size_t get_queued_bytes();
+
+    // writes are still accepted when not writable, the caller should drop or pause
+    bool is_writable() { return _writable; }
+
+    // the close callback runs once libuv closed the socket
     void close();
+
+private:
+    void update_writable();
+
+// implement IRsLoopCheck
+public:
+    void on_loop_check() override;
+
+private:
+    static void on_close(uv_handle_t *handle);
+
+    static void on_written(uv_write_t *req, int status);
+
+    void schedule_flush();
+
+    int flush();
 };
 
 #endif
@@ -0,0 +1,148 @@
+/*
+MIT License
+
+Copyright (c) 2016 ME_Kun_Han
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <atomic>
+#include "rs_kernel_loop.h"
+
+static thread_local RsLoop *current_loop = nullptr;
+
+RsLoop::RsLoop(uv_loop_t *loop) : _uv_loop(loop), _check(new uv_check_t()) {
+    _uv_loop->data = this;
+
+    uv_check_init(_uv_loop, _check);
+    _check->data = this;
+    // the pending checks should not keep the loop alive
+    uv_unref((uv_handle_t *) _check);
+}
+
+RsLoop::~RsLoop() {
+    auto handle = (uv_handle_t *) _check;
+    handle->data = nullptr;
+
+    if (uv_is_closing(handle)) {
+        // closed by the owner of the uv loop, which ran the loop to finish it
+        delete _check;
+    } else {
+        uv_close(handle, [](uv_handle_t *handle) {
+            delete (uv_check_t *) handle;
+        });
+    }
+
+    _uv_loop->data = nullptr;
+
+    if (current_loop == this) {
+        current_loop = nullptr;
+    }
+}
+
+size_t RsLoop::next_pool_index() {
+    static std::atomic<size_t> index(0);
+    return index++;
+}
+
+size_t RsLoop::get_live_count() {
+    size_t count = 0;
+    for (auto &pool : _pools) {
+        if (pool != nullptr) {
+            count += pool->live();
+        }
+    }
+    return count;
+}
+
+size_t RsLoop::get_pooled_count() {
+    size_t count = 0;
+    for (auto &pool : _pools) {
+        if (pool != nullptr) {
+            count += pool->pooled();
+        }
+    }
+    return count;
+}
+
+void RsLoop::on_check(uv_check_t *handle) {
+    auto loop = (RsLoop *) handle->data;
+
+    // checks scheduled by the running ones are run in this round too
+    while (!loop->_checks.empty()) {
+        loop->_running_checks.swap(loop->_checks);
+        for (size_t i = 0; i < loop->_running_checks.size(); i++) {
+            auto check = loop->_running_checks[i];
+            if (check != nullptr) {
+                check->on_loop_check();
+            }
+        }
+        loop->_running_checks.clear();
+    }
+
+    uv_check_stop(loop->_check);
+}
+
+void RsLoop::schedule_check(IRsLoopCheck *check) {
+    if (_checks.empty()) {
+        uv_check_start(_check, on_check);
+    }
+
+    _checks.push_back(check);
+}
+
+void RsLoop::cancel_check(IRsLoopCheck *check) {
+    std::replace(_checks.begin(), _checks.end(), check, (IRsLoopCheck *) nullptr);
+    std::replace(_running_checks.begin(), _running_checks.end(), check,
+                 (IRsLoopCheck *) nullptr);
+}
+
+RsTimingWheel *RsLoop::get_timing_wheel() {
+    if (_timing_wheel == nullptr) {
+        _timing_wheel.reset(new RsTimingWheel(_uv_loop));
+    }
+
+    return _timing_wheel.get();
+}
+
+std::shared_ptr<RsBufferPool> RsLoop::get_buffer_pool() {
+    if (_buffer_pool == nullptr) {
+        _buffer_pool = std::make_shared<RsBufferPool>();
+    }
+
+    return _buffer_pool;
+}
+
+RsLoop *RsLoop::from(uv_loop_t *loop) {
+    assert(loop->data != nullptr);
+    return (RsLoop *) loop->data;
+}
+
+RsLoop *RsLoop::get_instance() {
+    if (current_loop == nullptr) {
+        static RsLoop default_loop(uv_default_loop());
+        current_loop = &default_loop;
+    }
+
+    return current_loop;
+}
+
+void RsLoop::set_instance(RsLoop *loop) {
+    current_loop = loop;
+}
@@ -0,0 +1,137 @@
+/*
+MIT License
+
+Copyright (c) 2016 ME_Kun_Han
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef RS_KERNEL_LOOP_HEADER_H_
+#define RS_KERNEL_LOOP_HEADER_H_
+
+#include <uv.h>
+#include "rs_common.h"
+#include "rs_kernel_pool.h"
+#include "rs_kernel_timer.h"
+
+// size of the block handed to libuv for each read
+#define RS_READ_BLOCK_SIZE 4096
+
+struct RsReadBlock {
+    char data[RS_READ_BLOCK_SIZE];
+};
+
+/**
+ * work deferred to the end of current loop iteration, after all io callbacks
+ * of the iteration, so that the work queued by them can be batched.
+ */
+class IRsLoopCheck {
+public:
+    IRsLoopCheck() = default;
+
+    virtual ~IRsLoopCheck() = default;
+
+public:
+    virtual void on_loop_check() = 0;
+};
+
+/**
+ * the event loop and the state owned by it.
+ * every thread runs at most one loop, the loop can be found from any of its
+ * uv handles by RsLoop::from(handle->loop).
+ */
+class RsLoop {
+private:
+    uv_loop_t *_uv_loop;
+
+    // one pool per type, indexed by get_pool_index<T>()
+    std::vector<std::unique_ptr<IRsObjectPool>> _pools;
+
+    // on the heap, libuv may finish closing it after this loop is freed
+    uv_check_t *_check;
+    std::vector<IRsLoopCheck *> _checks;
+    std::vector<IRsLoopCheck *> _running_checks;
+
+    std::unique_ptr<RsTimingWheel> _timing_wheel;
+
+    std::shared_ptr<RsBufferPool> _buffer_pool;
+public:
+    explicit RsLoop(uv_loop_t *loop);
+
+    RsLoop(RsLoop const &) = delete;
+
+    RsLoop &operator=(RsLoop const &) = delete;
+
+    virtual ~RsLoop();
+
+private:
+    static size_t next_pool_index();
+
+    template<typename T>
+    static size_t get_pool_index() {
+        static const size_t index = next_pool_index();
+        return index;
+    }
+
+    static void on_check(uv_check_t *handle);
+
+public:
+    uv_loop_t *get_uv_loop() { return _uv_loop; }
+
+    template<typename T>
+    RsObjectPool<T> &get_pool() {
+        size_t index = get_pool_index<T>();
+        if (index >= _pools.size()) {
+            _pools.resize(index + 1);
+        }
+
+        if (_pools[index] == nullptr) {
+            _pools[index].reset(new RsObjectPool<T>());
+        }
+
+        return *static_cast<RsObjectPool<T> *>(_pools[index].get());
+    }
+
+    // sum of the counters of all pools in this loop
+    size_t get_live_count();
+
+    size_t get_pooled_count();
+
+    // run check->on_loop_check() once at the end of this iteration
+    void schedule_check(IRsLoopCheck *check);
+
+    void cancel_check(IRsLoopCheck *check);
+
+    // created on first use
+    RsTimingWheel *get_timing_wheel();
+
+    // created on first use, shared by the blocks handed out
+    std::shared_ptr<RsBufferPool> get_buffer_pool();
+
+public:
+    static RsLoop *from(uv_loop_t *loop);
+
+    // the loop of current thread, create one on the default uv loop if none
+    static RsLoop *get_instance();
+
+    // bind the loop to current thread, for the threads running their own loop
+    static void set_instance(RsLoop *loop);
+};
+
+#endif
@@ -0,0 +1,97 @@
+/*
+MIT License
+
+Copyright (c) 2016 ME_Kun_Han
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "rs_kernel_pool.h"
+
+RsBufferPool::RsBufferPool() : _owner(std::this_thread::get_id()),
+                               _free(RS_BUFFER_POOL_MAX_CLASS_BITS - RS_BUFFER_POOL_MIN_CLASS_BITS + 1),
+                               _live(0) {
+}
+
+RsBufferPool::~RsBufferPool() {
+    for (auto &blocks : _free) {
+        for (auto p : blocks) {
+            delete[] p;
+        }
+    }
+}
+
+int RsBufferPool::get_class(size_t size) {
+    int bits = RS_BUFFER_POOL_MIN_CLASS_BITS;
+    while (((size_t) 1 << bits) < size) {
+        if (++bits > RS_BUFFER_POOL_MAX_CLASS_BITS) {
+            return -1;
+        }
+    }
+
+    return bits - RS_BUFFER_POOL_MIN_CLASS_BITS;
+}
+
+void RsBufferPool::release(char *p, int size_class) {
+    auto &blocks = _free[size_class];
+    size_t block_size = (size_t) 1 << (size_class + RS_BUFFER_POOL_MIN_CLASS_BITS);
+
+    if (blocks.size() < 2 || (blocks.size() + 1) * block_size <= RS_BUFFER_POOL_CLASS_BYTES) {
+        blocks.push_back(p);
+        return;
+    }
+
+    delete[] p;
+}
+
+std::shared_ptr<char> RsBufferPool::allocate(size_t size) {
+    int size_class = get_class(size);
+    if (size_class < 0) {
+        return std::shared_ptr<char>(new char[size], std::default_delete<char[]>());
+    }
+
+    char *p = nullptr;
+    auto &blocks = _free[size_class];
+    if (blocks.empty()) {
+        p = new char[(size_t) 1 << (size_class + RS_BUFFER_POOL_MIN_CLASS_BITS)];
+    } else {
+        p = blocks.back();
+        blocks.pop_back();
+    }
+    _live++;
+
+    // the block keeps the pool alive, it may be dropped after the loop is gone
+    auto self = shared_from_this();
+    return std::shared_ptr<char>(p, [self, size_class](char *block) {
+        self->_live--;
+        if (std::this_thread::get_id() == self->_owner) {
+            self->release(block, size_class);
+        } else {
+            delete[] block;
+        }
+    });
+}
+
+size_t RsBufferPool::pooled() {
+    size_t n = 0;
+    for (auto &blocks : _free) {
+        n += blocks.size();
+    }
+    return n;
+}
@@ -0,0 +1,155 @@
+/*
+MIT License
+
+Copyright (c) 2016 ME_Kun_Han
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef RS_KERNEL_POOL_HEADER_H_
+#define RS_KERNEL_POOL_HEADER_H_
+
+#include <new>
+#include <atomic>
+#include <thread>
+#include "rs_common.h"
+
+class IRsObjectPool {
+public:
+    IRsObjectPool() = default;
+
+    virtual ~IRsObjectPool() = default;
+
+public:
+    // objects handed out and not released yet
+    virtual size_t live() = 0;
+
+    // released objects waiting to be reused
+    virtual size_t pooled() = 0;
+};
+
+/**
+ * slab pool for objects of one type, not thread safe.
+ * the memory is carved from slabs and kept in a free list once released,
+ * so it is only given back to the system when the pool is destroyed.
+ */
+template<typename T>
+class RsObjectPool : public IRsObjectPool {
+private:
+    // size of one slot, large enough to keep every slot aligned for T
+    static const size_t SLOT_SIZE = (sizeof(T) + alignof(T) - 1) / alignof(T) * alignof(T);
+
+    size_t _objects_per_slab;
+    std::vector<std::unique_ptr<char[]>> _slabs;
+    std::vector<void *> _free;
+    size_t _live;
+public:
+    explicit RsObjectPool(size_t objects_per_slab = 64)
+            : _objects_per_slab(objects_per_slab), _live(0) {};
+
+    RsObjectPool(RsObjectPool const &) = delete;
+
+    RsObjectPool &operator=(RsObjectPool const &) = delete;
+
+    ~RsObjectPool() override = default;
+
+private:
+    void grow() {
+        auto slab = std::unique_ptr<char[]>(new char[SLOT_SIZE * _objects_per_slab]);
+        for (size_t i = 0; i < _objects_per_slab; i++) {
+            _free.push_back(slab.get() + i * SLOT_SIZE);
+        }
+        _slabs.push_back(std::move(slab));
+    }
+
+public:
+    T *allocate() {
+        if (_free.empty()) {
+            grow();
+        }
+
+        void *mem = _free.back();
+        _free.pop_back();
+        _live++;
+
+        return new(mem) T();
+    }
+
+    void release(T *p) {
+        if (p == nullptr) {
+            return;
+        }
+
+        assert(_live > 0);
+
+        p->~T();
+        _free.push_back(p);
+        _live--;
+    }
+
+    size_t live() override { return _live; }
+
+    size_t pooled() override { return _free.size(); }
+};
+
+// the size classes of RsBufferPool are the powers of 2 in [2^8, 2^24]
+#define RS_BUFFER_POOL_MIN_CLASS_BITS 8
+#define RS_BUFFER_POOL_MAX_CLASS_BITS 24
+// bytes of released blocks kept in one size class, and at least 2 blocks
+#define RS_BUFFER_POOL_CLASS_BYTES (4 * 1024 * 1024)
+
+/**
+ * pool of byte blocks in power of 2 size classes, for the buffers of which the
+ * size is only known at runtime, like the payload of rtmp messages.
+ * the blocks are refcounted and go back to the pool when the last reference is
+ * dropped on the thread owning the pool, they are freed when dropped on other
+ * threads. larger blocks than the biggest class are not pooled.
+ */
+class RsBufferPool : public std::enable_shared_from_this<RsBufferPool> {
+private:
+    std::thread::id _owner;
+    std::vector<std::vector<char *>> _free;
+    std::atomic<size_t> _live;
+public:
+    RsBufferPool();
+
+    RsBufferPool(RsBufferPool const &) = delete;
+
+    RsBufferPool &operator=(RsBufferPool const &) = delete;
+
+    ~RsBufferPool();
+
+private:
+    // the index of the smallest class holding size bytes, -1 if too large
+    static int get_class(size_t size);
+
+    void release(char *p, int size_class);
+
+public:
+    // at least size bytes, the pool must be owned by a shared_ptr
+    std::shared_ptr<char> allocate(size_t size);
+
+    // blocks handed out and not released yet
+    size_t live() { return _live; }
+
+    // released blocks waiting to be reused
+    size_t pooled();
+};
+
+#endif
@@ -0,0 +1,163 @@
+/*
+MIT License
+
+Copyright (c) 2016 ME_Kun_Han
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef RS_KERNEL_QUEUE_HEADER_H_
+#define RS_KERNEL_QUEUE_HEADER_H_
+
+#include <atomic>
+#include "rs_common.h"
+
+/**
+ * unbounded lock free queue for many producers and one consumer.
+ * push never blocks and is wait free, pop is only called by the consumer, and
+ * may miss an item being pushed, which the producer signals afterwards anyway.
+ */
+template<typename T>
+class RsMPSCQueue {
+private:
+    struct Node {
+        std::atomic<Node *> next;
+        T value;
+
+        Node() : next(nullptr), value() {}
+
+        explicit Node(T v) : next(nullptr), value(std::move(v)) {}
+    };
+
+    // producers swap themselves in at head, the consumer follows next from tail
+    std::atomic<Node *> _head;
+    Node *_tail;
+public:
+    RsMPSCQueue() {
+        auto stub = new Node();
+        _head.store(stub, std::memory_order_relaxed);
+        _tail = stub;
+    }
+
+    RsMPSCQueue(RsMPSCQueue const &) = delete;
+
+    RsMPSCQueue &operator=(RsMPSCQueue const &) = delete;
+
+    ~RsMPSCQueue() {
+        T value;
+        while (pop(value)) {
+        }
+        delete _tail;
+    }
+
+public:
+    void push(T value) {
+        auto node = new Node(std::move(value));
+        auto prev = _head.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    bool pop(T &value) {
+        auto next = _tail->next.load(std::memory_order_acquire);
+        if (next == nullptr) {
+            return false;
+        }
+
+        value = std::move(next->value);
+        delete _tail;
+        _tail = next;
+
+        return true;
+    }
+};
+
+/**
+ * bounded lock free ring for one producer and one consumer.
+ * each side only stores its own index and loads the other by acquire. the
+ * producer may move between threads if the moves are ordered by a lock.
+ * the capacity is rounded up to a power of 2.
+ */
+template<typename T>
+class RsSPSCQueue {
+private:
+    std::vector<T> _slots;
+    size_t _mask;
+
+    // the next to pop, only stored by the consumer
+    std::atomic<size_t> _head;
+    // not on the cache line of the other index
+    char _padding[64];
+    // the next to push, only stored by the producer
+    std::atomic<size_t> _tail;
+public:
+    explicit RsSPSCQueue(size_t capacity) : _head(0), _tail(0) {
+        size_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+
+        _slots.resize(size);
+        _mask = size - 1;
+    }
+
+    RsSPSCQueue(RsSPSCQueue const &) = delete;
+
+    RsSPSCQueue &operator=(RsSPSCQueue const &) = delete;
+
+    ~RsSPSCQueue() = default;
+
+public:
+    // false when full, the value is not moved then
+    bool push(T &&value) {
+        auto tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _head.load(std::memory_order_acquire) == _slots.size()) {
+            return false;
+        }
+
+        _slots[tail & _mask] = std::move(value);
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool push(const T &value) {
+        T copy = value;
+        return push(std::move(copy));
+    }
+
+    // the slot is cleared, so that the value is released by the consumer
+    bool pop(T &value) {
+        auto head = _head.load(std::memory_order_relaxed);
+        if (head == _tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        value = std::move(_slots[head & _mask]);
+        _slots[head & _mask] = T();
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // exact on either side, a snapshot elsewhere
+    size_t size() {
+        return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() { return _slots.size(); }
+};
+
+#endif
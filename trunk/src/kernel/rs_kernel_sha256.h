@@ -0,0 +1,78 @@
+/*
+MIT License
+
+Copyright (c) 2016 ME_Kun_Han
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef RS_KERNEL_SHA256_HEADER_H_
+#define RS_KERNEL_SHA256_HEADER_H_
+
+#include "rs_common.h"
+#include "rs_kernel_slice.h"
+
+#define RS_SHA256_DIGEST_SIZE 32
+#define RS_SHA256_BLOCK_SIZE 64
+
+/**
+ * sha256 of FIPS 180-4, the state can be copied to resume from a common prefix.
+ */
+class RsSha256 {
+private:
+    uint32_t _state[8];
+    uint64_t _length;
+    uint8_t _block[RS_SHA256_BLOCK_SIZE];
+    size_t _block_size;
+public:
+    RsSha256();
+
+    ~RsSha256() = default;
+
+private:
+    void transform(const uint8_t *block);
+
+public:
+    void reset();
+
+    void update(const void *data, size_t size);
+
+    void final(uint8_t *digest);
+};
+
+/**
+ * hmac-sha256 of one key. the states after the inner and outer padded keys are
+ * computed once, so each signature only hashes the data and the inner digest.
+ */
+class RsHmacSha256 {
+private:
+    RsSha256 _inner;
+    RsSha256 _outer;
+public:
+    RsHmacSha256(const void *key, size_t size);
+
+    ~RsHmacSha256() = default;
+
+public:
+    // the digest of the parts one after another
+    void sign(const RsSlice *parts, size_t count, uint8_t *digest) const;
+
+    void sign(const void *data, size_t size, uint8_t *digest) const;
+};
+
+#endif
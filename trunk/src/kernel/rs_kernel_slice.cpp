@@ -0,0 +1,47 @@
+/*
+MIT License
+
+Copyright (c) 2016 ME_Kun_Han
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <cstring>
+#include "rs_kernel_slice.h"
+
+RsSharedSlice::RsSharedSlice(std::shared_ptr<char> holder, size_t size)
+        : _holder(holder), _data(holder.get()), _size(size) {
+}
+
+RsSharedSlice::RsSharedSlice(std::shared_ptr<char> holder, const char *data, size_t size)
+        : _holder(holder), _data(data), _size(size) {
+}
+
+RsSharedSlice RsSharedSlice::sub(size_t offset, size_t size) const {
+    assert(offset + size <= _size);
+    return RsSharedSlice(_holder, _data + offset, size);
+}
+
+RsSharedSlice RsSharedSlice::copy_from(const char *buf, size_t size) {
+    auto holder = std::shared_ptr<char>(new char[size], std::default_delete<char[]>());
+    if (size > 0) {
+        memcpy(holder.get(), buf, size);
+    }
+    return RsSharedSlice(holder, size);
+}
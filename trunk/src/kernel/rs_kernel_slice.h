@@ -0,0 +1,87 @@
+/*
+MIT License
+
+Copyright (c) 2016 ME_Kun_Han
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef RS_KERNEL_SLICE_HEADER_H_
+#define RS_KERNEL_SLICE_HEADER_H_
+
+#include "rs_common.h"
+
+/**
+ * a view of bytes owned by someone else, no copy and no reference.
+ * @remark, only valid until the owner is written or released.
+ */
+class RsSlice {
+public:
+    const char *data;
+    size_t size;
+public:
+    RsSlice() : data(nullptr), size(0) {};
+
+    RsSlice(const char *d, size_t s) : data(d), size(s) {};
+
+    ~RsSlice() = default;
+
+public:
+    bool empty() const { return size == 0; }
+
+    std::string to_string() const { return std::string(data, size); }
+};
+
+/**
+ * a view of refcounted bytes, the bytes are alive while any copy of the slice exists.
+ * copying or sub-slicing only bumps the reference count.
+ */
+class RsSharedSlice {
+private:
+    std::shared_ptr<char> _holder;
+    const char *_data;
+    size_t _size;
+public:
+    RsSharedSlice() : _holder(nullptr), _data(nullptr), _size(0) {};
+
+    RsSharedSlice(std::shared_ptr<char> holder, size_t size);
+
+    RsSharedSlice(std::shared_ptr<char> holder, const char *data, size_t size);
+
+    ~RsSharedSlice() = default;
+
+public:
+    const char *data() const { return _data; }
+
+    size_t size() const { return _size; }
+
+    bool empty() const { return _size == 0; }
+
+    RsSlice view() const { return RsSlice(_data, _size); }
+
+    // share [offset, offset + size) of this slice
+    RsSharedSlice sub(size_t offset, size_t size) const;
+
+    long use_count() const { return _holder.use_count(); }
+
+public:
+    static RsSharedSlice copy_from(const char *buf, size_t size);
+};
+
+#endif
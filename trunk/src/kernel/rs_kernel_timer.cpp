@@ -0,0 +1,216 @@
+/*
+MIT License
+
+Copyright (c) 2016 ME_Kun_Han
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "rs_kernel_timer.h"
+#include "rs_kernel_loop.h"
+
+RsTimer::RsTimer() : _wheel(nullptr), _expire(0), _param(nullptr) {
+}
+
+RsTimer::~RsTimer() {
+    cancel();
+}
+
+void RsTimer::set_callback(timeout_cb cb, void *param) {
+    _cb = std::move(cb);
+    _param = param;
+}
+
+void RsTimer::start(uint64_t timeout_ms) {
+    cancel();
+    RsLoop::get_instance()->get_timing_wheel()->arm(this, timeout_ms);
+}
+
+void RsTimer::cancel() {
+    if (_wheel != nullptr) {
+        _wheel->disarm(this);
+    }
+}
+
+RsTimingWheel::RsTimingWheel(uv_loop_t *loop) : _current(0), _count(0), _uv_loop(loop),
+                                                _uv_timer(uv_timer_t()) {
+    uv_timer_init(_uv_loop, &_uv_timer);
+    _uv_timer.data = this;
+    // the started timers should not keep the loop alive
+    uv_unref((uv_handle_t *) &_uv_timer);
+}
+
+RsTimingWheel::~RsTimingWheel() {
+    uv_timer_stop(&_uv_timer);
+
+    // the owners still hold the timers, they are just not started any more
+    for (auto &slot : _root) {
+        while (slot.next != &slot) {
+            auto timer = static_cast<RsTimer *>(slot.next);
+            unlink(timer);
+            timer->_wheel = nullptr;
+        }
+    }
+
+    for (auto &level : _levels) {
+        for (auto &slot : level) {
+            while (slot.next != &slot) {
+                auto timer = static_cast<RsTimer *>(slot.next);
+                unlink(timer);
+                timer->_wheel = nullptr;
+            }
+        }
+    }
+}
+
+void RsTimingWheel::link(RsTimerNode *list, RsTimerNode *node) {
+    node->prev = list->prev;
+    node->next = list;
+    list->prev->next = node;
+    list->prev = node;
+}
+
+void RsTimingWheel::unlink(RsTimerNode *node) {
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    node->prev = node;
+    node->next = node;
+}
+
+void RsTimingWheel::place(RsTimer *timer) {
+    auto next = _current + 1;
+
+    auto expire = timer->_expire;
+    // the expired ones run at the next tick
+    if (expire < next) {
+        expire = next;
+    }
+
+    auto delta = expire - next;
+    if (delta < ROOT_SIZE) {
+        link(&_root[expire & (ROOT_SIZE - 1)], timer);
+        return;
+    }
+
+    for (int level = 0; level < LEVELS; level++) {
+        int shift = ROOT_BITS + level * LEVEL_BITS;
+        if (delta < (1ull << (shift + LEVEL_BITS)) || level == LEVELS - 1) {
+            // beyond the wheel, parked in the farthest slot and placed again later
+            if (delta >= (1ull << (shift + LEVEL_BITS))) {
+                expire = next + (1ull << (shift + LEVEL_BITS)) - 1;
+            }
+
+            link(&_levels[level][(expire >> shift) & (LEVEL_SIZE - 1)], timer);
+            return;
+        }
+    }
+}
+
+void RsTimingWheel::cascade(int level, int index) {
+    RsTimerNode list;
+
+    // take the whole slot first, place may put timers back into it
+    auto &slot = _levels[level][index];
+    if (slot.next == &slot) {
+        return;
+    }
+
+    list.next = slot.next;
+    list.prev = slot.prev;
+    list.next->prev = &list;
+    list.prev->next = &list;
+    slot.next = slot.prev = &slot;
+
+    while (list.next != &list) {
+        auto timer = static_cast<RsTimer *>(list.next);
+        unlink(timer);
+        place(timer);
+    }
+}
+
+void RsTimingWheel::arm(RsTimer *timer, uint64_t timeout_ms) {
+    if (_count == 0) {
+        // the wheel was idle, catch up with the clock
+        _current = uv_now(_uv_loop) / RS_TIMER_TICK_MS;
+        uv_timer_start(&_uv_timer, on_tick, RS_TIMER_TICK_MS, RS_TIMER_TICK_MS);
+    }
+
+    auto ticks = (timeout_ms + RS_TIMER_TICK_MS - 1) / RS_TIMER_TICK_MS;
+    timer->_expire = _current + ticks;
+    timer->_wheel = this;
+    place(timer);
+    _count++;
+}
+
+void RsTimingWheel::disarm(RsTimer *timer) {
+    unlink(timer);
+    timer->_wheel = nullptr;
+
+    if (--_count == 0) {
+        uv_timer_stop(&_uv_timer);
+    }
+}
+
+void RsTimingWheel::advance(uint64_t now_ms) {
+    auto target = now_ms / RS_TIMER_TICK_MS;
+
+    while (_count > 0 && _current < target) {
+        auto tick = _current + 1;
+        auto index = static_cast<int>(tick & (ROOT_SIZE - 1));
+
+        // the root wraps, bring the timers of the next range down
+        if (index == 0) {
+            for (int level = 0; level < LEVELS; level++) {
+                int shift = ROOT_BITS + level * LEVEL_BITS;
+                auto level_index = static_cast<int>((tick >> shift) & (LEVEL_SIZE - 1));
+                cascade(level, level_index);
+                if (level_index != 0) {
+                    break;
+                }
+            }
+        }
+
+        RsTimerNode list;
+        auto &slot = _root[index];
+        if (slot.next != &slot) {
+            list.next = slot.next;
+            list.prev = slot.prev;
+            list.next->prev = &list;
+            list.prev->next = &list;
+            slot.next = slot.prev = &slot;
+        }
+
+        _current = tick;
+
+        // a callback may start or cancel any timer, the expired ones included
+        while (list.next != &list) {
+            auto timer = static_cast<RsTimer *>(list.next);
+            disarm(timer);
+
+            auto cb = timer->_cb;
+            if (cb) {
+                cb(timer->_param);
+            }
+        }
+    }
+}
+
+void RsTimingWheel::on_tick(uv_timer_t *handle) {
+    auto wheel = (RsTimingWheel *) handle->data;
+    wheel->advance(uv_now(handle->loop));
+}
@@ -0,0 +1,130 @@
+/*
+MIT License
+
+Copyright (c) 2016 ME_Kun_Han
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef RS_KERNEL_TIMER_HEADER_H_
+#define RS_KERNEL_TIMER_HEADER_H_
+
+#include <uv.h>
+#include "rs_common.h"
+
+// resolution of the timing wheel
+#define RS_TIMER_TICK_MS 10
+
+using timeout_cb = std::function<void(void *param)>;
+
+class RsTimingWheel;
+
+struct RsTimerNode {
+    RsTimerNode *prev;
+    RsTimerNode *next;
+
+    RsTimerNode() : prev(this), next(this) {}
+};
+
+/**
+ * one shot timeout on the timing wheel of a loop, usually a member of its owner.
+ * start and cancel are O(1), a started timer is restarted by start.
+ */
+class RsTimer : private RsTimerNode {
+    friend class RsTimingWheel;
+private:
+    RsTimingWheel *_wheel;
+    uint64_t _expire;
+    timeout_cb _cb;
+    void *_param;
+public:
+    RsTimer();
+
+    RsTimer(RsTimer const &) = delete;
+
+    RsTimer &operator=(RsTimer const &) = delete;
+
+    virtual ~RsTimer();
+
+public:
+    void set_callback(timeout_cb cb, void *param);
+
+    // fire once after timeout_ms, on the wheel of current loop
+    void start(uint64_t timeout_ms);
+
+    void cancel();
+
+    bool is_started() { return _wheel != nullptr; }
+};
+
+/**
+ * hierarchical timing wheel, one per loop and driven by a single uv timer.
+ * level 0 has a slot for each of the next 256 ticks, the 3 upper levels have 64
+ * slots each for ranges 64 times larger, their timers are cascaded down when
+ * the lower level wraps. the uv timer only runs while some timer is started.
+ */
+class RsTimingWheel {
+    friend class RsTimer;
+private:
+    static const int ROOT_BITS = 8;
+    static const int LEVEL_BITS = 6;
+    static const int LEVELS = 3;
+    static const int ROOT_SIZE = 1 << ROOT_BITS;
+    static const int LEVEL_SIZE = 1 << LEVEL_BITS;
+
+    RsTimerNode _root[ROOT_SIZE];
+    RsTimerNode _levels[LEVELS][LEVEL_SIZE];
+
+    // the last tick run, the timers started now count from it
+    uint64_t _current;
+    size_t _count;
+
+    uv_loop_t *_uv_loop;
+    uv_timer_t _uv_timer;
+public:
+    explicit RsTimingWheel(uv_loop_t *loop);
+
+    RsTimingWheel(RsTimingWheel const &) = delete;
+
+    RsTimingWheel &operator=(RsTimingWheel const &) = delete;
+
+    virtual ~RsTimingWheel();
+
+private:
+    static void on_tick(uv_timer_t *handle);
+
+    static void link(RsTimerNode *list, RsTimerNode *node);
+
+    static void unlink(RsTimerNode *node);
+
+    void place(RsTimer *timer);
+
+    void cascade(int level, int index);
+
+    void arm(RsTimer *timer, uint64_t timeout_ms);
+
+    void disarm(RsTimer *timer);
+
+public:
+    // run the timers expired at now_ms, in milliseconds of uv_now
+    void advance(uint64_t now_ms);
+
+    size_t get_count() { return _count; }
+};
+
+#endif
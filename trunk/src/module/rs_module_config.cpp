@@ -87,6 +87,28 @@ namespace rs_config {
         return ret;
     }
 
+    /**
+     * read an optional unsigned integer item, val is kept when there is no such item.
+     */
+    static int parse_optional_uint(const rapidjson::Value &obj, const char *key, uint32_t &val) {
+        int ret = ERROR_SUCCESS;
+
+        if (!obj.HasMember(key)) {
+            return ret;
+        }
+
+        const rapidjson::Value &itemVal = obj[key];
+        if (!itemVal.IsUint()) {
+            ret = ERROR_CONFIGURE_SYNTAX_INVALID;
+            rs_error(nullptr, "configure: %s should be unsigned integer. ret=%d", key, ret);
+            return ret;
+        }
+
+        val = itemVal.GetUint();
+
+        return ret;
+    }
+
     RsConfigBaseServer *
     RsConfigBaseServer::create_server_config(const rapidjson::Value &obj, int &ret) {
         if (!obj.IsObject()) {
@@ -146,6 +168,35 @@ namespace rs_config {
 
         server->listenPort = static_cast<uint32_t>(listenVal.GetInt());
 
+        // worker threads
+        if ((ret = parse_optional_uint(obj, "worker_threads", server->workerThreads)) !=
+            ERROR_SUCCESS) {
+            return nullptr;
+        }
+
+        if (server->workerThreads == 0) {
+            ret = ERROR_CONFIGURE_SYNTAX_INVALID;
+            rs_error(nullptr, "configure: worker_threads should be at least 1. ret=%d", ret);
+            return nullptr;
+        }
+
+        // listen mode
+        if (obj.HasMember("listen_mode")) {
+            const rapidjson::Value &modeVal = obj["listen_mode"];
+            std::string modeStr = modeVal.IsString() ? modeVal.GetString() : "";
+            if (modeStr == "reuseport") {
+                server->listenMode = RS_LISTEN_MODE_REUSEPORT;
+            } else if (modeStr == "dispatch") {
+                server->listenMode = RS_LISTEN_MODE_DISPATCH;
+            } else {
+                ret = ERROR_CONFIGURE_SYNTAX_INVALID;
+                rs_error(nullptr,
+                         "configure: listen_mode should be reuseport or dispatch. ret=%d",
+                         ret);
+                return nullptr;
+            }
+        }
+
         if ((ret = server->initialize(obj)) != ERROR_SUCCESS) {
             rs_error(nullptr, "initialize server=%s, type=%s, port=%d failed. ret=%d",
                      server->name.c_str(), typeStr.c_str(), server->listenPort, ret);
@@ -157,6 +208,122 @@ namespace rs_config {
     int RsConfigRTMPServer::initialize(const rapidjson::Value &obj) {
         int ret = ERROR_SUCCESS;
 
+        if (!obj.HasMember("rtmp-server")) {
+            return ret;
+        }
+
+        const rapidjson::Value &rtmpVal = obj["rtmp-server"];
+        if (!rtmpVal.IsObject()) {
+            ret = ERROR_CONFIGURE_SYNTAX_INVALID;
+            rs_error(nullptr, "configure: rtmp-server item should be object. ret=%d", ret);
+            return ret;
+        }
+
+        if ((ret = parse_optional_uint(rtmpVal, "write_high_watermark", writeHighWatermark)) !=
+            ERROR_SUCCESS) {
+            return ret;
+        }
+
+        if ((ret = parse_optional_uint(rtmpVal, "write_low_watermark", writeLowWatermark)) !=
+            ERROR_SUCCESS) {
+            return ret;
+        }
+
+        if (writeHighWatermark != 0 && writeLowWatermark > writeHighWatermark) {
+            ret = ERROR_CONFIGURE_SYNTAX_INVALID;
+            rs_error(nullptr, "configure: write_low_watermark=%u is above write_high_watermark=%u."
+                     " ret=%d", writeLowWatermark, writeHighWatermark, ret);
+            return ret;
+        }
+
+        if ((ret = parse_optional_uint(rtmpVal, "handshake_timeout_ms", handshakeTimeout)) !=
+            ERROR_SUCCESS) {
+            return ret;
+        }
+
+        if ((ret = parse_optional_uint(rtmpVal, "idle_timeout_ms", idleTimeout)) !=
+            ERROR_SUCCESS) {
+            return ret;
+        }
+
+        if ((ret = parse_optional_uint(rtmpVal, "send_stall_timeout_ms", sendStallTimeout)) !=
+            ERROR_SUCCESS) {
+            return ret;
+        }
+
+        if ((ret = parse_optional_uint(rtmpVal, "max_message_size", maxMessageSize)) !=
+            ERROR_SUCCESS) {
+            return ret;
+        }
+
+        if (maxMessageSize < MIN_MAX_MESSAGE_SIZE || maxMessageSize > MAX_MAX_MESSAGE_SIZE) {
+            ret = ERROR_CONFIGURE_SYNTAX_INVALID;
+            rs_error(nullptr, "configure: max_message_size=%u should be in [%u, %u]. ret=%d",
+                     maxMessageSize, MIN_MAX_MESSAGE_SIZE, MAX_MAX_MESSAGE_SIZE, ret);
+            return ret;
+        }
+
+        if ((ret = parse_optional_uint(rtmpVal, "out_chunk_size", outChunkSize)) !=
+            ERROR_SUCCESS) {
+            return ret;
+        }
+
+        if (outChunkSize < MIN_OUT_CHUNK_SIZE || outChunkSize > MAX_OUT_CHUNK_SIZE) {
+            ret = ERROR_CONFIGURE_SYNTAX_INVALID;
+            rs_error(nullptr, "configure: out_chunk_size=%u should be in [%u, %u]. ret=%d",
+                     outChunkSize, MIN_OUT_CHUNK_SIZE, MAX_OUT_CHUNK_SIZE, ret);
+            return ret;
+        }
+
+        if ((ret = parse_optional_uint(rtmpVal, "ack_window_size", ackWindowSize)) !=
+            ERROR_SUCCESS) {
+            return ret;
+        }
+
+        if (ackWindowSize == 0) {
+            ret = ERROR_CONFIGURE_SYNTAX_INVALID;
+            rs_error(nullptr, "configure: ack_window_size should not be 0. ret=%d", ret);
+            return ret;
+        }
+
+        if ((ret = parse_optional_uint(rtmpVal, "gop_cache_max_duration_ms", gopCacheMaxDuration)) !=
+            ERROR_SUCCESS) {
+            return ret;
+        }
+
+        if ((ret = parse_optional_uint(rtmpVal, "gop_cache_max_bytes", gopCacheMaxBytes)) !=
+            ERROR_SUCCESS) {
+            return ret;
+        }
+
+        if ((ret = parse_optional_uint(rtmpVal, "merged_write_ms", mergedWriteWindow)) !=
+            ERROR_SUCCESS) {
+            return ret;
+        }
+
+        if (mergedWriteWindow > MAX_MERGED_WRITE_WINDOW) {
+            ret = ERROR_CONFIGURE_SYNTAX_INVALID;
+            rs_error(nullptr, "configure: merged_write_ms=%u should be in [0, %u]. ret=%d",
+                     mergedWriteWindow, MAX_MERGED_WRITE_WINDOW, ret);
+            return ret;
+        }
+
+        if ((ret = parse_optional_uint(rtmpVal, "merged_write_messages", mergedWriteMessages)) !=
+            ERROR_SUCCESS) {
+            return ret;
+        }
+
+        if ((ret = parse_optional_uint(rtmpVal, "consumer_queue_size", consumerQueueSize)) !=
+            ERROR_SUCCESS) {
+            return ret;
+        }
+
+        if (consumerQueueSize == 0) {
+            ret = ERROR_CONFIGURE_SYNTAX_INVALID;
+            rs_error(nullptr, "configure: consumer_queue_size should not be 0. ret=%d", ret);
+            return ret;
+        }
+
         return ret;
     }
 
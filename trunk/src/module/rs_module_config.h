@@ -62,20 +62,34 @@ namespace rs_config {
         RS_SERVER_TYPE_RTMP = 0
     };
 
+    enum RS_LISTEN_MODE {
+        // every worker listens on the port, the kernel picks the worker
+        RS_LISTEN_MODE_REUSEPORT = 0,
+        // worker 0 accepts, and hands the socket to the worker with fewest connections
+        RS_LISTEN_MODE_DISPATCH
+    };
+
     static const RS_SERVER_TYPE DEFAULT_SERVER_TYPE = RS_SERVER_TYPE_RTMP;
     static const uint32_t DEFAULT_SERVER_PORT = 1935;
     static const char *DEFAULT_SERVER_NAME = "default-rtmp-server";
+    // threads running the server, each with its own loop and listener
+    static const uint32_t DEFAULT_SERVER_WORKER_THREADS = 1;
+    static const RS_LISTEN_MODE DEFAULT_SERVER_LISTEN_MODE = RS_LISTEN_MODE_REUSEPORT;
 
     class RsConfigBaseServer {
     private:
         uint32_t listenPort;
         std::string name;
         RS_SERVER_TYPE type;
+        uint32_t workerThreads;
+        RS_LISTEN_MODE listenMode;
     public:
         RsConfigBaseServer() {
             listenPort = DEFAULT_SERVER_PORT;
             name = DEFAULT_SERVER_NAME;
             type = DEFAULT_SERVER_TYPE;
+            workerThreads = DEFAULT_SERVER_WORKER_THREADS;
+            listenMode = DEFAULT_SERVER_LISTEN_MODE;
         };
 
         virtual ~RsConfigBaseServer() = default;
@@ -86,6 +100,10 @@ namespace rs_config {
         virtual RS_SERVER_TYPE const &get_type() { return type; };
 
         virtual std::string const &get_server_name() { return name; };
+
+        virtual uint32_t get_worker_threads() { return workerThreads; };
+
+        virtual RS_LISTEN_MODE get_listen_mode() { return listenMode; };
     public:
 
         virtual int initialize(const rapidjson::Value &val) = 0;
@@ -95,15 +113,113 @@ namespace rs_config {
         create_server_config(const rapidjson::Value &obj, int &ret);
     };
 
+    // bytes queued for one connection before it stops being writable
+    static const uint32_t DEFAULT_WRITE_HIGH_WATERMARK = 4 * 1024 * 1024;
+    // bytes the queue must drain to before being writable again
+    static const uint32_t DEFAULT_WRITE_LOW_WATERMARK = 1024 * 1024;
+
+    // timeouts of rtmp connections in milliseconds, 0 to disable
+    // from accepted to c2 received
+    static const uint32_t DEFAULT_HANDSHAKE_TIMEOUT = 10 * 1000;
+    // nothing received from the peer
+    static const uint32_t DEFAULT_IDLE_TIMEOUT = 60 * 1000;
+    // not writable, the peer does not read what is sent
+    static const uint32_t DEFAULT_SEND_STALL_TIMEOUT = 30 * 1000;
+
+    // the largest rtmp message accepted from the peer, the length field allows 16MB,
+    // and a command such as connect should fit
+    static const uint32_t DEFAULT_MAX_MESSAGE_SIZE = 8 * 1024 * 1024;
+    static const uint32_t MIN_MAX_MESSAGE_SIZE = 4096;
+    static const uint32_t MAX_MAX_MESSAGE_SIZE = 0xffffff;
+
+    // the chunk size of the messages sent by server, told to the peer after connect
+    static const uint32_t DEFAULT_OUT_CHUNK_SIZE = 60000;
+    static const uint32_t MIN_OUT_CHUNK_SIZE = 128;
+    static const uint32_t MAX_OUT_CHUNK_SIZE = 65536;
+
+    // the window of acknowledgement asked from the peer, the unacknowledged bytes
+    // sent to the peer are bounded to twice of it once the peer acknowledges
+    static const uint32_t DEFAULT_ACK_WINDOW_SIZE = 2500000;
+
+    // the gop kept for new players is dropped when longer or bigger, 0 to disable the gop cache
+    static const uint32_t DEFAULT_GOP_CACHE_MAX_DURATION = 10 * 1000;
+    static const uint32_t DEFAULT_GOP_CACHE_MAX_BYTES = 16 * 1024 * 1024;
+
+    // the media for a player is sent by one write once the window since the first
+    // message passed, or earlier when the messages are many, 0 to send at once
+    static const uint32_t DEFAULT_MERGED_WRITE_WINDOW = 0;
+    // a longer window delays the players more than the writes it saves
+    static const uint32_t MAX_MERGED_WRITE_WINDOW = 500;
+    // 0 for no limit of messages in the window
+    static const uint32_t DEFAULT_MERGED_WRITE_MESSAGES = 0;
+
+    // the messages queued for a player, rounded up to a power of 2. when full, the
+    // player drops until next keyframe
+    static const uint32_t DEFAULT_CONSUMER_QUEUE_SIZE = 2048;
+
     class RsConfigRTMPServer : public RsConfigBaseServer {
         std::string name;
+        uint32_t writeHighWatermark;
+        uint32_t writeLowWatermark;
+        uint32_t handshakeTimeout;
+        uint32_t idleTimeout;
+        uint32_t sendStallTimeout;
+        uint32_t maxMessageSize;
+        uint32_t outChunkSize;
+        uint32_t ackWindowSize;
+        uint32_t gopCacheMaxDuration;
+        uint32_t gopCacheMaxBytes;
+        uint32_t mergedWriteWindow;
+        uint32_t mergedWriteMessages;
+        uint32_t consumerQueueSize;
     public:
-        RsConfigRTMPServer() = default;
+        RsConfigRTMPServer() {
+            writeHighWatermark = DEFAULT_WRITE_HIGH_WATERMARK;
+            writeLowWatermark = DEFAULT_WRITE_LOW_WATERMARK;
+            handshakeTimeout = DEFAULT_HANDSHAKE_TIMEOUT;
+            idleTimeout = DEFAULT_IDLE_TIMEOUT;
+            sendStallTimeout = DEFAULT_SEND_STALL_TIMEOUT;
+            maxMessageSize = DEFAULT_MAX_MESSAGE_SIZE;
+            outChunkSize = DEFAULT_OUT_CHUNK_SIZE;
+            ackWindowSize = DEFAULT_ACK_WINDOW_SIZE;
+            gopCacheMaxDuration = DEFAULT_GOP_CACHE_MAX_DURATION;
+            gopCacheMaxBytes = DEFAULT_GOP_CACHE_MAX_BYTES;
+            mergedWriteWindow = DEFAULT_MERGED_WRITE_WINDOW;
+            mergedWriteMessages = DEFAULT_MERGED_WRITE_MESSAGES;
+            consumerQueueSize = DEFAULT_CONSUMER_QUEUE_SIZE;
+        };
 
         ~RsConfigRTMPServer() override = default;
 
     public:
         int initialize(const rapidjson::Value &obj) override;
+
+    public:
+        uint32_t get_write_high_watermark() { return writeHighWatermark; }
+
+        uint32_t get_write_low_watermark() { return writeLowWatermark; }
+
+        uint32_t get_handshake_timeout() { return handshakeTimeout; }
+
+        uint32_t get_idle_timeout() { return idleTimeout; }
+
+        uint32_t get_send_stall_timeout() { return sendStallTimeout; }
+
+        uint32_t get_max_message_size() { return maxMessageSize; }
+
+        uint32_t get_out_chunk_size() { return outChunkSize; }
+
+        uint32_t get_ack_window_size() { return ackWindowSize; }
+
+        uint32_t get_gop_cache_max_duration() { return gopCacheMaxDuration; }
+
+        uint32_t get_gop_cache_max_bytes() { return gopCacheMaxBytes; }
+
+        uint32_t get_merged_write_window() { return mergedWriteWindow; }
+
+        uint32_t get_merged_write_messages() { return mergedWriteMessages; }
+
+        uint32_t get_consumer_queue_size() { return consumerQueueSize; }
     };
 
     using ConfigServerContainer = std::map<std::string, std::shared_ptr<RsConfigBaseServer>>;
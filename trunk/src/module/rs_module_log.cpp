@@ -39,64 +39,59 @@ const int32_t RS_LOG_MAX_LENGTH = 4096;
 
 namespace rs_log {
 
-    RsLogManager::RsLogManager() : msg(nullptr), log_interface(nullptr) {
-        msg = std::shared_ptr<char>(new char[RS_LOG_MAX_LENGTH]);
+    // every thread formats its messages in its own buffer
+    static thread_local char log_buffer[RS_LOG_MAX_LENGTH];
+
+    RsLogManager::RsLogManager() : log_interface(nullptr) {
+    }
+
+    void RsLogManager::do_log(IRsIO *io, const char *level, const char *fmt, va_list ap) {
+        auto size = vsnprintf(log_buffer, RS_LOG_MAX_LENGTH, fmt, ap);
+        if (size < 0) {
+            return;
+        }
+
+        // the message is truncated when longer than the buffer
+        size = std::min(size, RS_LOG_MAX_LENGTH - 1);
+
+        auto cid = RsConnContext::getInstance()->get_id(io);
+
+        log(cid, level, std::string(log_buffer, static_cast<unsigned long>(size)));
     }
 
     void RsLogManager::info(IRsIO *io, const char *fmt, ...) {
         va_list ap;
         va_start(ap, fmt);
-        auto size = vsnprintf(msg.get(), RS_LOG_MAX_LENGTH, fmt, ap);
+        do_log(io, RS_LOG_LEVEL_INFO, fmt, ap);
         va_end(ap);
-
-        auto cid = RsConnContext::getInstance()->get_id(io);
-
-        log(cid, RS_LOG_LEVEL_INFO, std::string(msg.get(), static_cast<unsigned long>(size)));
     }
 
     void RsLogManager::verbose(IRsIO *io, const char *fmt, ...) {
         va_list ap;
         va_start(ap, fmt);
-        auto size = vsnprintf(msg.get(), RS_LOG_MAX_LENGTH, fmt, ap);
+        do_log(io, RS_LOG_LEVEL_VERBOSE, fmt, ap);
         va_end(ap);
-
-        auto cid = RsConnContext::getInstance()->get_id(io);
-
-        log(cid, RS_LOG_LEVEL_VERBOSE,
-            std::string(msg.get(), static_cast<unsigned long>(size)));
     }
 
     void RsLogManager::trace(IRsIO *io, const char *fmt, ...) {
         va_list ap;
         va_start(ap, fmt);
-        auto size = vsnprintf(msg.get(), RS_LOG_MAX_LENGTH, fmt, ap);
+        do_log(io, RS_LOG_LEVEL_TRACE, fmt, ap);
         va_end(ap);
-
-        auto cid = RsConnContext::getInstance()->get_id(io);
-
-        log(cid, RS_LOG_LEVEL_TRACE, std::string(msg.get(), static_cast<unsigned long>(size)));
     }
 
     void RsLogManager::warn(IRsIO *io, const char *fmt, ...) {
         va_list ap;
         va_start(ap, fmt);
-        auto size = vsnprintf(msg.get(), RS_LOG_MAX_LENGTH, fmt, ap);
+        do_log(io, RS_LOG_LEVEL_WARN, fmt, ap);
         va_end(ap);
-
-        auto cid = RsConnContext::getInstance()->get_id(io);
-
-        log(cid, RS_LOG_LEVEL_WARN, std::string(msg.get(), static_cast<unsigned long>(size)));
     }
 
     void RsLogManager::error(IRsIO *io, const char *fmt, ...) {
         va_list ap;
         va_start(ap, fmt);
-        auto size = vsnprintf(msg.get(), RS_LOG_MAX_LENGTH, fmt, ap);
+        do_log(io, RS_LOG_LEVEL_ERROR, fmt, ap);
         va_end(ap);
-
-        auto cid = RsConnContext::getInstance()->get_id(io);
-
-        log(cid, RS_LOG_LEVEL_ERROR, std::string(msg.get(), static_cast<unsigned long>(size)));
     }
 
     void RsConsoleLog::log(int64_t cid, std::string level, std::string message) {
@@ -108,7 +103,8 @@ namespace rs_log {
             return;
         }
 
-        auto ptr_time = gmtime(&tv.tv_sec);
+        tm tm_time{};
+        auto ptr_time = gmtime_r(&tv.tv_sec, &tm_time);
 
         // [2017-08-01 14:23:32.893]
         ss << "[" << 1900 + ptr_time->tm_year << "-" << 1 + ptr_time->tm_mon << "-"
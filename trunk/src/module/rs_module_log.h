@@ -28,6 +28,7 @@ The log system for rtmp server
 #define RS_MODULE_LOG_H_
 
 #include <unistd.h>
+#include <cstdarg>
 #include "rs_common.h"
 #include "rs_kernel_io.h"
 
@@ -61,7 +62,6 @@ namespace rs_log {
 
     class RsLogManager {
     private:
-        std::shared_ptr<char> msg;
         std::shared_ptr<IRsLog> log_interface;
     public:
         RsLogManager();
@@ -74,6 +74,10 @@ namespace rs_log {
 
         virtual ~RsLogManager() = default;
 
+    private:
+        // format into the buffer of current thread, then log it
+        void do_log(IRsIO *io, const char *level, const char *fmt, va_list ap);
+
     public:
 
         void change_log_interface(IRsLog *inter) {
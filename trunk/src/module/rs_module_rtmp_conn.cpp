@@ -26,9 +26,7 @@ SOFTWARE.
 #include "rs_module_rtmp_conn.h"
 #include "rs_protocol_rtmp.h"
 
-RsRtmpConn::RsRtmpConn() : _rtmp_status(RS_RTMP_CONN_STATUS::uninitialized),
-               _cached_message(nullptr) {
-    _cached_message = std::shared_ptr<RsRtmpChunkMsgAsync>(new RsRtmpChunkMsgAsync());
+RsRtmpConn::RsRtmpConn() : _rtmp_status(RS_RTMP_CONN_STATUS::uninitialized) {
 }
 
 RsRtmpConn::~RsRtmpConn() {
@@ -43,16 +41,26 @@ int RsRtmpConn::initialize(IRsIO *io) {
     return ret;
 }
 
-void RsRtmpConn::update_status() {
-}
+RsServerRtmpConn::RsServerRtmpConn(rs_config::RsConfigRTMPServer *config)
+        : _config(config), _publishing(false), _stream_created(false), _in_bytes(0), _in_acked(0),
+          _in_ack_window(0), _out_bytes(0), _out_acked(0), _out_ack_received(false), _peer_bandwidth(0),
+          _peer_bandwidth_type(RS_RTMP_PEER_BANDWIDTH_DYNAMIC), _play_started_at(0), _time_to_first_frame(-1) {
+    assert(_config != nullptr);
+    _handshake.set_callbacks(on_handshake_reply, on_handshake_done, this);
+
+    _handshake_timer.set_callback(on_handshake_timeout, this);
+    _idle_timer.set_callback(on_idle_timeout, this);
+    _send_stall_timer.set_callback(on_send_stall_timeout, this);
 
-RsServerRtmpConn::RsServerRtmpConn() {
-    _rs_buffer = std::shared_ptr<RsBufferLittleEndian>(new RsBufferLittleEndian());
+    _chunk_decoder.set_message_cb(on_rtmp_message, this);
+    _chunk_decoder.set_max_message_size(_config->get_max_message_size());
 }
 
 RsServerRtmpConn::~RsServerRtmpConn() {
     rs_info(_tcp_io.get(), "rtmp deconstruction");
 
+    stop_stream();
+
     change_connection_status(rs_connection_stopped);
 }
 
@@ -64,6 +72,10 @@ int RsServerRtmpConn::initialize(IRsIO *io) {
 
     _tcp_io.reset(ptr);
 
+    _tcp_io->set_watermarks(_config->get_write_high_watermark(),
+                            _config->get_write_low_watermark());
+    _tcp_io->set_drain_cb(on_drain, this);
+    _tcp_io->set_close_cb(on_close, this);
 
     if ((ret = _tcp_io->start_read(on_message, this)) != ERROR_SUCCESS) {
         rs_error(_tcp_io.get(), "start reading failed. ret=%d", ret);
@@ -72,92 +84,597 @@ int RsServerRtmpConn::initialize(IRsIO *io) {
 
     change_connection_status(rs_connection_running);
 
+    if (_config->get_handshake_timeout() > 0) {
+        _handshake_timer.start(_config->get_handshake_timeout());
+    }
+
+    if (_config->get_idle_timeout() > 0) {
+        _idle_timer.start(_config->get_idle_timeout());
+    }
+
+    return ret;
+}
+
+void RsServerRtmpConn::on_close(void *param) {
+    auto pt = (RsServerRtmpConn *) param;
+
+    rs_info(pt->_tcp_io.get(), "rtmp connection closed");
+
+    pt->stop_stream();
+
+    pt->notify_stopped();
+}
+
+bool RsServerRtmpConn::is_writable() {
+    if (!_tcp_io->is_writable()) {
+        return false;
+    }
+
+    // only bounded for the peers which acknowledge at all
+    if (!_out_ack_received) {
+        return true;
+    }
+
+    // one window being acknowledged while the next is sent
+    uint64_t limit = 2 * (uint64_t) _config->get_ack_window_size();
+    if (_peer_bandwidth > 0) {
+        limit = std::min(limit, (uint64_t) _peer_bandwidth);
+    }
+
+    return get_unacked_bytes() < limit;
+}
+
+uint32_t RsServerRtmpConn::get_unacked_bytes() {
+    // the peer counts the handshake as well, so it may acknowledge a little more than sent
+    auto unacked = _out_bytes - _out_acked;
+    return (int32_t) unacked < 0 ? 0 : unacked;
+}
+
+int RsServerRtmpConn::send_message(const RsRtmpMessage &msg) {
+    _send_slices.clear();
+    _out_bytes += (uint32_t) _chunk_encoder.encode(msg, _send_slices);
+
+    return write_send_slices(msg.type_id);
+}
+
+int RsServerRtmpConn::send_message(RsRtmpSharedMessage &msg) {
+    _send_slices.clear();
+    _out_bytes += (uint32_t) _chunk_encoder.encode(msg, _send_slices);
+
+    return write_send_slices(msg.get_message().type_id);
+}
+
+int RsServerRtmpConn::write_send_slices(uint8_t type_id) {
+    int ret = ERROR_SUCCESS;
+
+    for (auto &slice : _send_slices) {
+        if ((ret = _tcp_io->write(slice)) != ERROR_SUCCESS) {
+            break;
+        }
+    }
+    _send_slices.clear();
+
+    if (ret != ERROR_SUCCESS) {
+        rs_error(_tcp_io.get(), "send rtmp message failed, type=%d. ret=%d", type_id, ret);
+        return ret;
+    }
+
+    check_send_stall();
+
     return ret;
 }
 
-void RsServerRtmpConn::update_status() {
-    if (_tcp_io->is_stop()) {
-        change_connection_status(rs_connection_stopped);
+void RsServerRtmpConn::on_drain(void *param) {
+    auto pt = (RsServerRtmpConn *) param;
+
+    rs_info(pt->_tcp_io.get(), "rtmp connection is writable again");
+    pt->_send_stall_timer.cancel();
+
+    pt->play_messages();
+}
+
+void RsServerRtmpConn::check_send_stall() {
+    if (_config->get_send_stall_timeout() == 0 || _send_stall_timer.is_started()) {
+        return;
+    }
+
+    if (!_tcp_io->is_writable()) {
+        _send_stall_timer.start(_config->get_send_stall_timeout());
     }
 }
 
+void RsServerRtmpConn::on_handshake_timeout(void *param) {
+    auto pt = (RsServerRtmpConn *) param;
+
+    rs_warn(pt->_tcp_io.get(), "rtmp handshake not done in %ums, close it",
+            pt->_config->get_handshake_timeout());
+    pt->_tcp_io->close();
+}
+
+void RsServerRtmpConn::on_idle_timeout(void *param) {
+    auto pt = (RsServerRtmpConn *) param;
+
+    rs_warn(pt->_tcp_io.get(), "nothing received from rtmp connection in %ums, close it",
+            pt->_config->get_idle_timeout());
+    pt->_tcp_io->close();
+}
+
+void RsServerRtmpConn::on_send_stall_timeout(void *param) {
+    auto pt = (RsServerRtmpConn *) param;
+
+    rs_warn(pt->_tcp_io.get(), "rtmp connection not writable for %ums, close it",
+            pt->_config->get_send_stall_timeout());
+    pt->_tcp_io->close();
+}
+
 void RsServerRtmpConn::on_message(char *buf, ssize_t size, void *param) {
     auto pt = (RsServerRtmpConn *) param;
 
     auto io = pt->_tcp_io;
-    auto buffer = pt->_rs_buffer;
-    auto cache_msg = pt->_cached_message;
 
     rs_info(io.get(), "get message from tcp io, size=%d", size);
 
+    if (pt->_config->get_idle_timeout() > 0) {
+        pt->_idle_timer.start(pt->_config->get_idle_timeout());
+    }
+
     auto ret = ERROR_SUCCESS;
 
-    buffer->write_bytes(buf, static_cast<int>(size));
-    // do handshake
-    if (pt->_rtmp_status == RS_RTMP_CONN_STATUS::uninitialized) {
-        // get c0c1
-        RtmpHandshakeC0C1 c0c1_obj;
-        if ((ret = c0c1_obj.initialize(buffer.get())) != ERROR_SUCCESS) {
-            rs_error(io.get(), "decode c0c1 failed. ret=%d", ret);
-            return ;
-        }
+    pt->_in_bytes += (uint32_t) size;
 
-        // create s0s1s2
-        RtmpHandshakeS0S1 s0s11;
-        if ((ret = s0s11.initialize()) != ERROR_SUCCESS) {
-            rs_error(io.get(), "create s0s1 failed. ret=%d", ret);
-            return ;
-        }
+    // the chunks are decoded in place from the read buffer after handshake
+    if (pt->_rtmp_status == RS_RTMP_CONN_STATUS::established) {
+        pt->decode_chunks(buf, static_cast<size_t>(size));
+        return;
+    }
 
-        RtmpHandshakeS2 s21;
-        if ((ret = s21.initialize(c0c1_obj.timestamp, c0c1_obj.random_data)) != ERROR_SUCCESS) {
-            rs_error(io.get(), "create s2 failed. ret=%d", ret);
-            return ;
-        }
+    if ((ret = pt->_handshake.on_msg(buf, static_cast<size_t>(size))) != ERROR_SUCCESS) {
+        rs_error(io.get(), "rtmp handshake failed, close it. ret=%d", ret);
+        io->close();
+    }
+}
+
+int RsServerRtmpConn::on_handshake_reply(const RsSharedSlice &s0s1s2, void *param) {
+    auto pt = (RsServerRtmpConn *) param;
+    int ret = ERROR_SUCCESS;
+
+    if ((ret = pt->_tcp_io->write(s0s1s2)) != ERROR_SUCCESS) {
+        rs_error(pt->_tcp_io.get(), "send s0s1s2 failed. ret=%d", ret);
+        return ret;
+    }
+    pt->_out_bytes += (uint32_t) s0s1s2.size();
+    pt->check_send_stall();
+
+    pt->_rtmp_status = RS_RTMP_CONN_STATUS::c0c1_received;
+    return ret;
+}
+
+int RsServerRtmpConn::on_handshake_done(const char *buf, size_t size, void *param) {
+    auto pt = (RsServerRtmpConn *) param;
+
+    pt->_rtmp_status = RS_RTMP_CONN_STATUS::established;
+    pt->_handshake_timer.cancel();
+
+    rs_info(pt->_tcp_io.get(), "get c2 successfully");
+
+    // the chunks sent along with c2
+    if (size > 0) {
+        pt->decode_chunks(buf, size);
+    }
+
+    return ERROR_SUCCESS;
+}
+
+void RsServerRtmpConn::decode_chunks(const char *buf, size_t size) {
+    auto ret = ERROR_SUCCESS;
+
+    if ((ret = _chunk_decoder.on_msg(buf, size)) != ERROR_SUCCESS) {
+        rs_error(_tcp_io.get(), "decode rtmp chunks failed, close it. ret=%d", ret);
+        _tcp_io->close();
+        return;
+    }
+
+    if ((ret = check_ack()) != ERROR_SUCCESS) {
+        _tcp_io->close();
+    }
+}
+
+int RsServerRtmpConn::check_ack() {
+    if (_in_ack_window == 0 || _in_bytes - _in_acked < _in_ack_window) {
+        return ERROR_SUCCESS;
+    }
+
+    _in_acked = _in_bytes;
+    return send_message(rs_rtmp_create_control_message(RS_RTMP_MSG_ACKNOWLEDGEMENT, _in_bytes));
+}
+
+int RsServerRtmpConn::on_window_ack_size(const RsRtmpMessage &msg) {
+    int ret = ERROR_SUCCESS;
+
+    uint32_t window = 0;
+    if ((ret = rs_rtmp_decode_control_message(msg, window)) != ERROR_SUCCESS) {
+        return ret;
+    }
+
+    rs_info(_tcp_io.get(), "peer asks acknowledgement every %u bytes", window);
+
+    // counted from now on
+    _in_ack_window = window;
+    _in_acked = _in_bytes;
+
+    return ret;
+}
+
+int RsServerRtmpConn::on_acknowledgement(const RsRtmpMessage &msg) {
+    int ret = ERROR_SUCCESS;
+
+    uint32_t sequence = 0;
+    if ((ret = rs_rtmp_decode_control_message(msg, sequence)) != ERROR_SUCCESS) {
+        return ret;
+    }
+
+    bool writable = is_writable();
+    _out_acked = sequence;
+    _out_ack_received = true;
+
+    // the player waits for the window to be acknowledged, nothing else wakes it up
+    if (!writable && is_writable()) {
+        play_messages();
+    }
+
+    return ret;
+}
+
+int RsServerRtmpConn::on_set_peer_bandwidth(const RsRtmpMessage &msg) {
+    int ret = ERROR_SUCCESS;
 
-        std::string str = s0s11.dump() + s21.dump();
-        if ((ret = io->write(str, static_cast<int>(str.size()))) != ERROR_SUCCESS) {
-            rs_error(io.get(), "send s0s1s2 failed. ret=%d", ret);
-            return ;
+    uint32_t window = 0;
+    if ((ret = rs_rtmp_decode_control_message(msg, window)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    uint8_t type = msg.payload.size() > 4 ? (uint8_t) msg.payload.data()[4] : RS_RTMP_PEER_BANDWIDTH_HARD;
+
+    // soft only lowers the limit, dynamic is hard if the last one was hard
+    if (type == RS_RTMP_PEER_BANDWIDTH_DYNAMIC) {
+        if (_peer_bandwidth_type != RS_RTMP_PEER_BANDWIDTH_HARD) {
+            return ret;
         }
+        type = RS_RTMP_PEER_BANDWIDTH_HARD;
+    }
+
+    if (type == RS_RTMP_PEER_BANDWIDTH_SOFT && _peer_bandwidth > 0 && window > _peer_bandwidth) {
+        return ret;
+    }
+
+    rs_info(_tcp_io.get(), "peer limits the unacknowledged bytes to %u, type=%d", window, type);
+    _peer_bandwidth = window;
+    _peer_bandwidth_type = type;
+
+    return ret;
+}
+
+int RsServerRtmpConn::on_rtmp_message(RsRtmpMessage &msg, void *param) {
+    auto pt = (RsServerRtmpConn *) param;
+
+    rs_info(pt->_tcp_io.get(), "get rtmp message, type=%d, cs_id=%u, timestamp=%u, length=%u",
+            msg.type_id, msg.cs_id, msg.timestamp, (uint32_t) msg.payload.size());
+
+    switch (msg.type_id) {
+        case RS_RTMP_MSG_SET_CHUNK_SIZE:
+            return pt->on_set_chunk_size(msg);
+        case RS_RTMP_MSG_WINDOW_ACK_SIZE:
+            return pt->on_window_ack_size(msg);
+        case RS_RTMP_MSG_ACKNOWLEDGEMENT:
+            return pt->on_acknowledgement(msg);
+        case RS_RTMP_MSG_SET_PEER_BANDWIDTH:
+            return pt->on_set_peer_bandwidth(msg);
+        case RS_RTMP_MSG_AMF0_COMMAND:
+            return pt->on_command(msg);
+        case RS_RTMP_MSG_AUDIO:
+        case RS_RTMP_MSG_VIDEO:
+        case RS_RTMP_MSG_AMF0_DATA:
+            return pt->on_media(msg);
+        default:
+            // TODO:FIXME: achieve other handler for rtmp messages
+            return ERROR_SUCCESS;
+    }
+}
+
+int RsServerRtmpConn::on_set_chunk_size(const RsRtmpMessage &msg) {
+    int ret = ERROR_SUCCESS;
+
+    uint32_t chunk_size = 0;
+    if ((ret = rs_rtmp_decode_control_message(msg, chunk_size)) != ERROR_SUCCESS) {
+        return ret;
+    }
+
+    if (chunk_size < RS_RTMP_MIN_CHUNK_SIZE || chunk_size > RS_RTMP_MAX_CHUNK_SIZE) {
+        ret = ERROR_RTMP_PROTOCOL_CHUNK_SIZE_INVALID;
+        rs_error(_tcp_io.get(), "chunk size %u of peer should be in [%u, %u]. ret=%d", chunk_size,
+                 RS_RTMP_MIN_CHUNK_SIZE, RS_RTMP_MAX_CHUNK_SIZE, ret);
+        return ret;
+    }
+
+    rs_info(_tcp_io.get(), "set chunk size of peer from %u to %u", _chunk_decoder.get_chunk_size(),
+            chunk_size);
+    _chunk_decoder.set_chunk_size(chunk_size);
+
+    return ret;
+}
+
+int RsServerRtmpConn::on_command(const RsRtmpMessage &msg) {
+    int ret = ERROR_SUCCESS;
 
-        // change status
-        pt->_rtmp_status = RS_RTMP_CONN_STATUS::c0c1_received;
-        return ;
+    RsRtmpCommand cmd;
+    if ((ret = cmd.initialize(msg)) != ERROR_SUCCESS) {
+        rs_error(_tcp_io.get(), "decode rtmp command failed. ret=%d", ret);
+        return ret;
+    }
+
+    if (cmd.name == "connect") {
+        return on_connect(cmd);
+    } else if (cmd.name == "createStream") {
+        return on_create_stream(cmd);
+    } else if (cmd.name == "publish") {
+        return on_publish(cmd);
+    } else if (cmd.name == "play") {
+        return on_play(cmd);
+    } else if (cmd.name == "releaseStream" || cmd.name == "FCPublish") {
+        return send_result(cmd);
+    } else if (cmd.name == "FCUnpublish" || cmd.name == "deleteStream" || cmd.name == "closeStream") {
+        stop_stream();
+        return ret;
+    }
+
+    rs_info(_tcp_io.get(), "ignore rtmp command %s", cmd.name.c_str());
+    return ret;
+}
+
+int RsServerRtmpConn::on_connect(RsRtmpCommand &cmd) {
+    int ret = ERROR_SUCCESS;
+
+    auto obj = dynamic_cast<RsAmf0Object *>(cmd.get(0));
+    if (obj == nullptr) {
+        ret = ERROR_RTMP_PROTOCOL_COMMAND_ERROR;
+        rs_error(_tcp_io.get(), "connect without command object. ret=%d", ret);
+        return ret;
+    }
+
+    auto app = dynamic_cast<RsAmf0String *>(obj->get("app"));
+    auto tc_url = dynamic_cast<RsAmf0String *>(obj->get("tcUrl"));
+    _app = app ? app->value : "";
+    _tc_url = tc_url ? tc_url->value : "";
+
+    rs_info(_tcp_io.get(), "connect app=%s, tcUrl=%s", _app.c_str(), _tc_url.c_str());
+
+    // ask the peer to acknowledge, and limit what it sends unacknowledged likewise
+    auto window = _config->get_ack_window_size();
+    if ((ret = send_message(rs_rtmp_create_control_message(RS_RTMP_MSG_WINDOW_ACK_SIZE, window))) !=
+        ERROR_SUCCESS) {
+        return ret;
+    }
+
+    if ((ret = send_message(rs_rtmp_create_set_peer_bandwidth(window, RS_RTMP_PEER_BANDWIDTH_DYNAMIC))) !=
+        ERROR_SUCCESS) {
+        return ret;
     }
 
-    // get c2
-    if (pt->_rtmp_status == RS_RTMP_CONN_STATUS::c0c1_received) {
-        if (buffer->length() < 1536) {
+    // the larger chunks from now on, the fewer headers and writes for big frames
+    auto chunk_size = _config->get_out_chunk_size();
+    if ((ret = send_message(rs_rtmp_create_control_message(RS_RTMP_MSG_SET_CHUNK_SIZE, chunk_size))) !=
+        ERROR_SUCCESS) {
+        return ret;
+    }
+    _chunk_encoder.set_chunk_size(chunk_size);
+
+    RsRtmpCommand result;
+    result.name = "_result";
+    result.transaction_id = cmd.transaction_id;
+
+    auto props = new RsAmf0Object();
+    props->set("fmsVer", new RsAmf0String("FMS/3,5,3,888"));
+    props->set("capabilities", new RsAmf0Number(127));
+    props->set("mode", new RsAmf0Number(1));
+    result.add(props);
+
+    auto info = new RsAmf0Object();
+    info->set("level", new RsAmf0String("status"));
+    info->set("code", new RsAmf0String("NetConnection.Connect.Success"));
+    info->set("description", new RsAmf0String("Connection succeeded."));
+    info->set("objectEncoding", new RsAmf0Number(0));
+    result.add(info);
+
+    return send_message(result.dump(0));
+}
+
+int RsServerRtmpConn::send_result(RsRtmpCommand &cmd) {
+    RsRtmpCommand result;
+    result.name = "_result";
+    result.transaction_id = cmd.transaction_id;
+    result.add(new RsAmf0Null());
+    result.add(new RsAmf0Undefined());
+
+    return send_message(result.dump(0));
+}
+
+int RsServerRtmpConn::send_status(const std::string &level, const std::string &code,
+                                  const std::string &description) {
+    RsRtmpCommand status;
+    status.name = "onStatus";
+    status.add(new RsAmf0Null());
+
+    auto info = new RsAmf0Object();
+    info->set("level", new RsAmf0String(level));
+    info->set("code", new RsAmf0String(code));
+    info->set("description", new RsAmf0String(description));
+    status.add(info);
+
+    return send_message(status.dump(RS_RTMP_STREAM_ID));
+}
+
+int RsServerRtmpConn::on_create_stream(RsRtmpCommand &cmd) {
+    // one stream for each connection, to publish or play
+    _stream_created = true;
+
+    RsRtmpCommand result;
+    result.name = "_result";
+    result.transaction_id = cmd.transaction_id;
+    result.add(new RsAmf0Null());
+    result.add(new RsAmf0Number(RS_RTMP_STREAM_ID));
+
+    return send_message(result.dump(0));
+}
+
+int RsServerRtmpConn::on_publish(RsRtmpCommand &cmd) {
+    int ret = ERROR_SUCCESS;
+
+    auto name = dynamic_cast<RsAmf0String *>(cmd.get(1));
+    if (!_stream_created || _source != nullptr || name == nullptr) {
+        ret = ERROR_SOURCE_STREAM_NOT_CREATED;
+        rs_error(_tcp_io.get(), "publish before createStream or without name. ret=%d", ret);
+        return ret;
+    }
+
+    auto source = RsRtmpSourceManager::get_instance()->fetch_or_create(rs_rtmp_get_source_key(_app, name->value));
+    if (!source->on_publish()) {
+        // left open, the status queued would be dropped by closing now
+        rs_warn(_tcp_io.get(), "source %s is published by another", source->get_key().c_str());
+        return send_status("error", "NetStream.Publish.BadName", "Stream already publishing.");
+    }
+
+    _source = source;
+    _publishing = true;
+    _source->set_gop_cache(_config->get_gop_cache_max_duration(), _config->get_gop_cache_max_bytes());
+    _source->set_frame_chunk_size(_config->get_out_chunk_size());
+    rs_info(_tcp_io.get(), "publish source %s", _source->get_key().c_str());
+
+    return send_status("status", "NetStream.Publish.Start", "Start publishing.");
+}
+
+int RsServerRtmpConn::on_play(RsRtmpCommand &cmd) {
+    int ret = ERROR_SUCCESS;
+
+    auto name = dynamic_cast<RsAmf0String *>(cmd.get(1));
+    if (!_stream_created || _source != nullptr || name == nullptr) {
+        ret = ERROR_SOURCE_STREAM_NOT_CREATED;
+        rs_error(_tcp_io.get(), "play before createStream or without name. ret=%d", ret);
+        return ret;
+    }
+
+    if ((ret = send_message(rs_rtmp_create_user_control(RS_RTMP_USER_STREAM_BEGIN, RS_RTMP_STREAM_ID))) !=
+        ERROR_SUCCESS) {
+        return ret;
+    }
+
+    if ((ret = send_status("status", "NetStream.Play.Reset", "Playing and resetting stream.")) != ERROR_SUCCESS) {
+        return ret;
+    }
+
+    if ((ret = send_status("status", "NetStream.Play.Start", "Started playing stream.")) != ERROR_SUCCESS) {
+        return ret;
+    }
+
+    // the player waits on the source until it is published
+    _source = RsRtmpSourceManager::get_instance()->fetch_or_create(rs_rtmp_get_source_key(_app, name->value));
+    _play_started_at = rs_get_system_time_ms();
+    _consumer.reset(new RsRtmpConsumer(on_consumer, this, _config->get_consumer_queue_size()));
+    _consumer->set_merged_write(_config->get_merged_write_window(), _config->get_merged_write_messages());
+    _source->attach(_consumer.get());
+
+    rs_info(_tcp_io.get(), "play source %s", _source->get_key().c_str());
+    return ret;
+}
+
+int RsServerRtmpConn::on_media(const RsRtmpMessage &msg) {
+    if (!_publishing) {
+        rs_warn(_tcp_io.get(), "ignore message type=%d of no publish", msg.type_id);
+        return ERROR_SUCCESS;
+    }
+
+    _source->on_message(msg);
+    return ERROR_SUCCESS;
+}
+
+void RsServerRtmpConn::on_consumer(void *param) {
+    auto pt = (RsServerRtmpConn *) param;
+    pt->play_messages();
+}
+
+void RsServerRtmpConn::play_messages() {
+    if (_consumer == nullptr) {
+        return;
+    }
+
+    auto frames = _consumer->take_start_frames();
+    if (frames != nullptr && send_start_frames(*frames) != ERROR_SUCCESS) {
+        _tcp_io->close();
+        return;
+    }
+
+    // the rest is sent once drained, or closed by send stall timer
+    std::shared_ptr<RsRtmpSharedMessage> msg;
+    while (is_writable() && _consumer->dequeue(msg)) {
+        if (send_message(*msg) != ERROR_SUCCESS) {
+            _tcp_io->close();
             return;
         }
 
-        std::string str_c2;
-        buffer->read(str_c2, 1536);
+        // the sequence header is not a picture to show
+        auto &m = msg->get_message();
+        if (_time_to_first_frame < 0 && rs_rtmp_is_video_keyframe(m) && !rs_rtmp_is_video_sequence_header(m)) {
+            _time_to_first_frame = rs_get_system_time_ms() - _play_started_at;
+            rs_info(_tcp_io.get(), "first frame of %s sent in %dms", _source->get_key().c_str(),
+                    (int) _time_to_first_frame);
+        }
+    }
+}
+
+int RsServerRtmpConn::send_start_frames(RsRtmpStartFrames &frames) {
+    int ret = ERROR_SUCCESS;
 
-        // change status
-        pt->_rtmp_status = RS_RTMP_CONN_STATUS::c2_received;
+    if (frames.chunk_size != _chunk_encoder.get_chunk_size()) {
+        for (auto &msg : frames.messages) {
+            if ((ret = send_message(*msg)) != ERROR_SUCCESS) {
+                return ret;
+            }
+        }
+        return ret;
+    }
 
+    if ((ret = _tcp_io->write(frames.frames)) != ERROR_SUCCESS) {
+        rs_error(_tcp_io.get(), "send start frames failed. ret=%d", ret);
+        return ret;
+    }
+    _out_bytes += (uint32_t) frames.frames.size();
 
-        rs_info(io.get(), "get c2 successfully");
-        return ;
+    for (auto &msg : frames.messages) {
+        _chunk_encoder.on_framed(msg->get_message());
     }
 
-    rs_info(io.get(), "msg: %s", buf);
+    check_send_stall();
 
-    // reset cache message
-    std::vector<uint8_t > msg(buf, buf + size);
+    return ret;
+}
 
-    // receive connect cmd
-    if (pt->_rtmp_status == RS_RTMP_CONN_STATUS::c2_received) {
-        cache_msg->on_msg(msg);
+void RsServerRtmpConn::stop_stream() {
+    if (_source == nullptr) {
+        return;
     }
 
-    pt->_rtmp_status = RS_RTMP_CONN_STATUS::established;
+    if (_publishing) {
+        rs_info(_tcp_io.get(), "unpublish source %s", _source->get_key().c_str());
+        _source->on_unpublish();
+        _publishing = false;
+    }
 
-    if (cache_msg->is_completed()) {
-        cache_msg->clear();
+    if (_consumer != nullptr) {
+        _source->detach(_consumer.get());
+        if (_consumer->get_dropped_count() > 0) {
+            rs_warn(_tcp_io.get(), "player of %s dropped %llu messages as it fell behind",
+                    _source->get_key().c_str(), (unsigned long long) _consumer->get_dropped_count());
+        }
+        _consumer.reset();
     }
 
-    // TODO:FIXME: achieve other handler for rtmp messages
+    _source.reset();
 }
@@ -29,8 +29,11 @@ SOFTWARE.
 #include <rs_kernel_buffer.h>
 #include "rs_common.h"
 #include "rs_kernel_io.h"
+#include "rs_kernel_timer.h"
 #include "rs_kernel_connection.h"
 #include "rs_protocol_rtmp.h"
+#include "rs_module_config.h"
+#include "rs_module_source.h"
 
 /**
  * the basic rtmp connection class
@@ -41,12 +44,13 @@ protected:
     enum class RS_RTMP_CONN_STATUS {
         uninitialized = 0,
         c0c1_received,
-        c2_received,
         established,
     } _rtmp_status;
 
-
-    std::shared_ptr<RsRtmpChunkMsgAsync> _cached_message;
+    // reassembles the messages from the chunks after handshake
+    RsRtmpChunkMsgAsync _chunk_decoder;
+    // chunks the messages to send
+    RsRtmpChunkEncoder _chunk_encoder;
 
 public:
     RsRtmpConn();
@@ -55,8 +59,6 @@ public:
 
 public:
     int initialize(IRsIO *io) override;
-
-    void update_status() override;
 };
 
 /**
@@ -64,22 +66,136 @@ public:
  */
 class RsServerRtmpConn : public RsRtmpConn {
 private:
+    rs_config::RsConfigRTMPServer *_config;
+
     std::shared_ptr<RsTCPSocketIO> _tcp_io;
 
-    std::shared_ptr<RsBufferLittleEndian> _rs_buffer;
+    RtmpHandshakeAsync _handshake;
+
+    RsTimer _handshake_timer;
+    RsTimer _idle_timer;
+    RsTimer _send_stall_timer;
+
+    // reused by every send_message
+    std::vector<RsSharedSlice> _send_slices;
+
+    // from the connect command
+    std::string _app;
+    std::string _tc_url;
+
+    // the source published or played, null before publish or play
+    std::shared_ptr<RsRtmpSource> _source;
+    bool _publishing;
+    // only for player
+    std::unique_ptr<RsRtmpConsumer> _consumer;
+    bool _stream_created;
+
+    // flow control, the byte counts wrap at 4GB like the sequence number of acknowledgement
+    uint32_t _in_bytes;
+    uint32_t _in_acked;
+    // from window acknowledgement size of peer, 0 before that
+    uint32_t _in_ack_window;
+    uint32_t _out_bytes;
+    uint32_t _out_acked;
+    bool _out_ack_received;
+    // from set peer bandwidth, 0 for no limit
+    uint32_t _peer_bandwidth;
+    uint8_t _peer_bandwidth_type;
+
+    // from play to the first keyframe written, -1 before that
+    int64_t _play_started_at;
+    int64_t _time_to_first_frame;
 public:
-    RsServerRtmpConn();
+    explicit RsServerRtmpConn(rs_config::RsConfigRTMPServer *config);
 
     ~RsServerRtmpConn() override;
 
 private:
     static void on_message(char *, ssize_t, void *);
 
+    static void on_drain(void *);
+
+    static void on_close(void *);
+
+    static int on_handshake_reply(const RsSharedSlice &s0s1s2, void *param);
+
+    static int on_handshake_done(const char *buf, size_t size, void *param);
+
+    static int on_rtmp_message(RsRtmpMessage &msg, void *param);
+
+    // feed the chunk decoder, the connection is closed on error
+    void decode_chunks(const char *buf, size_t size);
+
+    // acknowledge the bytes received once the window of peer is reached
+    int check_ack();
+
+    int on_window_ack_size(const RsRtmpMessage &msg);
+
+    int on_acknowledgement(const RsRtmpMessage &msg);
+
+    int on_set_peer_bandwidth(const RsRtmpMessage &msg);
+
+    int on_set_chunk_size(const RsRtmpMessage &msg);
+
+    int on_command(const RsRtmpMessage &msg);
+
+    int on_connect(RsRtmpCommand &cmd);
+
+    int on_create_stream(RsRtmpCommand &cmd);
+
+    int on_publish(RsRtmpCommand &cmd);
+
+    int on_play(RsRtmpCommand &cmd);
+
+    // _result of the commands which need no more than an answer
+    int send_result(RsRtmpCommand &cmd);
+
+    int send_status(const std::string &level, const std::string &code, const std::string &description);
+
+    // audio, video and data of publisher, for the players of the source
+    int on_media(const RsRtmpMessage &msg);
+
+    static void on_consumer(void *param);
+
+    // send what the consumer queued until not writable
+    void play_messages();
+
+    // as is if framed for our chunk size, otherwise message by message
+    int send_start_frames(RsRtmpStartFrames &frames);
+
+    // unpublish or stop playing
+    void stop_stream();
+
+    static void on_handshake_timeout(void *);
+
+    static void on_idle_timeout(void *);
+
+    static void on_send_stall_timeout(void *);
+
+    // start the send stall timer once the output is queued up
+    void check_send_stall();
+
+    // write the slices encoded by send_message
+    int write_send_slices(uint8_t type_id);
+
 public:
     int initialize(IRsIO *io) override;
 
-    void update_status() override;
+    // false when the peer does not read fast enough, stop sending until drained
+    // or acknowledged
+    bool is_writable();
+
+    // queue the chunks of msg, the payload is referenced and not copied
+    int send_message(const RsRtmpMessage &msg);
+
+    // the chunks are shared with the other connections of same chunk size
+    int send_message(RsRtmpSharedMessage &msg);
+
+    // sent and not acknowledged by peer yet
+    uint32_t get_unacked_bytes();
 
+    // the milliseconds a player waited for the first keyframe, -1 if not yet
+    int64_t get_time_to_first_frame() { return _time_to_first_frame; }
 };
 
 #endif
\ No newline at end of file
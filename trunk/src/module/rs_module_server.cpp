@@ -23,14 +23,91 @@ SOFTWARE.
 */
 
 #include <memory>
+#include <sstream>
+#include <unistd.h>
 #include "rs_kernel_io.h"
+#include "rs_kernel_loop.h"
 #include "rs_module_server.h"
 #include "rs_module_config.h"
 #include "rs_common_utility.h"
 #include "rs_module_config.h"
 #include "rs_module_log.h"
 
-RsRtmpServer::RsRtmpServer() {
+RsConnectionDispatcher::RsConnectionDispatcher(uint32_t workers) : _servers(workers, nullptr),
+                                                                    _connections(workers) {
+    for (uint32_t i = 0; i < workers; i++) {
+        _connections[i].store(0);
+    }
+}
+
+void RsConnectionDispatcher::attach(uint32_t worker, RsRtmpServer *server) {
+    assert(worker < _servers.size());
+    std::lock_guard<std::mutex> lock(_mutex);
+    _servers[worker] = server;
+}
+
+void RsConnectionDispatcher::detach(uint32_t worker) {
+    assert(worker < _servers.size());
+    std::lock_guard<std::mutex> lock(_mutex);
+    _servers[worker] = nullptr;
+}
+
+RsRtmpServer *RsConnectionDispatcher::pick(uint32_t &worker) {
+    RsRtmpServer *target = nullptr;
+    int fewest = 0;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (uint32_t i = 0; i < _servers.size(); i++) {
+        auto server = _servers[i];
+        if (server == nullptr) {
+            continue;
+        }
+
+        // only the accepting loop increases the counts, so they can only drop meanwhile
+        auto connections = _connections[i].load();
+        if (target == nullptr || connections < fewest) {
+            target = server;
+            fewest = connections;
+            worker = i;
+        }
+    }
+
+    if (target != nullptr) {
+        _connections[worker]++;
+    }
+
+    return target;
+}
+
+int RsConnectionDispatcher::post(uint32_t worker, uv_os_sock_t fd) {
+    assert(worker < _servers.size());
+
+    // the server detaches before closing its inbox, so it is alive while locked
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_servers[worker] == nullptr) {
+        return ERROR_SERVER_WORKER_DETACHED;
+    }
+
+    _servers[worker]->post_connection(fd);
+    return ERROR_SUCCESS;
+}
+
+void RsConnectionDispatcher::on_connection_closed(uint32_t worker) {
+    assert(worker < _connections.size());
+    _connections[worker]--;
+}
+
+std::vector<int> RsConnectionDispatcher::get_connection_counts() {
+    std::vector<int> counts;
+    for (auto &i : _connections) {
+        counts.push_back(i.load());
+    }
+    return counts;
+}
+
+RsRtmpServer::RsRtmpServer(uint32_t worker, std::shared_ptr<RsConnectionDispatcher> dispatcher)
+        : _worker(worker), _config(nullptr), _dispatcher(std::move(dispatcher)),
+          _inbox_async(uv_async_t()), _inbox_initialized(false) {
     _listen_sock = std::unique_ptr<RsTCPListener>(new RsTCPListener());
 }
 
@@ -46,24 +123,150 @@ void RsRtmpServer::on_new_connection(IRsReaderWriter *io, void *param) {
     auto *pt_this = (RsRtmpServer *) param;
     assert(pt_this != nullptr);
 
+    if (pt_this->_dispatcher == nullptr) {
+        pt_this->add_connection(io);
+        return;
+    }
+
+    int ret = ERROR_SUCCESS;
+
+    uint32_t worker = pt_this->_worker;
+    auto target = pt_this->_dispatcher->pick(worker);
+
+    std::stringstream counts;
+    for (auto count : pt_this->_dispatcher->get_connection_counts()) {
+        counts << " " << count;
+    }
+    rs_info(io, "dispatch connection to worker=%u, connections of workers:%s", worker,
+            counts.str().c_str());
+
+    if (target == pt_this) {
+        pt_this->add_connection(io);
+        return;
+    }
+
+    auto socket_io = dynamic_cast<RsTCPSocketIO *>(io);
+    assert(socket_io != nullptr);
+
+    uv_os_sock_t fd;
+    ret = socket_io->detach(fd);
+    rs_free_p(socket_io);
+
+    if (ret != ERROR_SUCCESS) {
+        rs_error(nullptr, "detach connection for worker=%u failed. ret=%d", worker, ret);
+        pt_this->_dispatcher->on_connection_closed(worker);
+        return;
+    }
+
+    if ((ret = pt_this->_dispatcher->post(worker, fd)) != ERROR_SUCCESS) {
+        rs_warn(nullptr, "worker=%u is stopped, drop the connection. ret=%d", worker, ret);
+        ::close(fd);
+        pt_this->_dispatcher->on_connection_closed(worker);
+        return;
+    }
+}
+
+void RsRtmpServer::on_dispatched(uv_async_t *async) {
+    auto pt_this = (RsRtmpServer *) async->data;
+    assert(pt_this != nullptr);
+
     int ret = ERROR_SUCCESS;
 
-    auto conn = std::shared_ptr<RsServerRtmpConn>(new RsServerRtmpConn());
+    uv_os_sock_t fd;
+    while (pt_this->_inbox.pop(fd)) {
+        auto io = new RsTCPSocketIO();
+        if ((ret = io->initialize(fd)) != ERROR_SUCCESS) {
+            rs_error(io, "open dispatched connection failed. ret=%d", ret);
+            rs_free_p(io);
+            ::close(fd);
+            pt_this->_dispatcher->on_connection_closed(pt_this->_worker);
+            continue;
+        }
+
+        pt_this->add_connection(io);
+    }
+}
+
+void RsRtmpServer::post_connection(uv_os_sock_t fd) {
+    _inbox.push(fd);
+    uv_async_send(&_inbox_async);
+}
+
+void RsRtmpServer::add_connection(IRsReaderWriter *io) {
+    int ret = ERROR_SUCCESS;
+
+    size_t slot = _connections.size();
+    if (!_free_slots.empty()) {
+        slot = _free_slots.back();
+        _free_slots.pop_back();
+    } else {
+        _connections.emplace_back();
+    }
+
+    auto conn = std::shared_ptr<RsServerRtmpConn>(new RsServerRtmpConn(_config));
+    conn->set_slot(slot);
+    conn->set_stopped_cb(on_connection_stopped, this);
+    _connections[slot] = conn;
+
     if ((ret = conn->initialize(io)) != ERROR_SUCCESS) {
         rs_error(io, "initialize the rtmp connection failed. ret=%d", ret);
+        _connections[slot] = nullptr;
+        _free_slots.push_back(slot);
+        if (_dispatcher != nullptr) {
+            _dispatcher->on_connection_closed(_worker);
+        }
         return;
     }
+}
+
+void RsRtmpServer::on_connection_stopped(RsConnection *conn, void *param) {
+    auto pt_this = (RsRtmpServer *) param;
+    assert(pt_this != nullptr);
+
+    auto slot = conn->get_slot();
+    assert(slot < pt_this->_connections.size() && pt_this->_connections[slot].get() == conn);
+
+    // the connection and its io are freed here
+    pt_this->_connections[slot] = nullptr;
+    pt_this->_free_slots.push_back(slot);
 
-    pt_this->_connections.push_back(conn);
+    if (pt_this->_dispatcher != nullptr) {
+        pt_this->_dispatcher->on_connection_closed(pt_this->_worker);
+    }
 }
 
 int RsRtmpServer::initialize(rs_config::RsConfigBaseServer *config) {
     int ret = ERROR_SUCCESS;
 
+    _config = dynamic_cast<rs_config::RsConfigRTMPServer *>(config);
+    assert(_config != nullptr);
+
     rs_info(_listen_sock.get(), "ready to initialize a new rtmp server, name=%s, port=%d",
             config->get_server_name().c_str(), config->get_port());
 
-    _listen_sock->initialize("0.0.0.0", config->get_port(), on_new_connection, this);
+    if (_dispatcher != nullptr) {
+        if ((ret = uv_async_init(RsLoop::get_instance()->get_uv_loop(), &_inbox_async,
+                                 on_dispatched)) != ERROR_SUCCESS) {
+            rs_error(nullptr, "initialize the inbox of rtmp server failed. ret=%d", ret);
+            return ret;
+        }
+
+        _inbox_async.data = this;
+        _inbox_initialized = true;
+        _dispatcher->attach(_worker, this);
+
+        // only worker 0 accepts, the others wait for the dispatched sockets
+        if (_worker != 0) {
+            return ret;
+        }
+    }
+
+    bool reuse_port = _dispatcher == nullptr && config->get_worker_threads() > 1;
+    if ((ret = _listen_sock->initialize("0.0.0.0", config->get_port(), on_new_connection, this,
+                                        reuse_port)) != ERROR_SUCCESS) {
+        rs_error(_listen_sock.get(), "initialize listener of rtmp server failed. ret=%d", ret);
+        return ret;
+    }
 
     return ret;
 }
@@ -71,38 +274,66 @@ int RsRtmpServer::initialize(rs_config::RsConfigBaseServer *config) {
 int RsRtmpServer::dispose() {
     int ret = ERROR_SUCCESS;
 
-    return ret;
-}
+    _listen_sock->close();
+    _connections.clear();
+    _free_slots.clear();
 
-int RsRtmpServer::update_status() {
-    int ret = ERROR_SUCCESS;
+    if (_dispatcher != nullptr) {
+        _dispatcher->detach(_worker);
+    }
 
-    for (auto i = _connections.begin(); i != _connections.end();) {
-        auto conn = *i;
-        conn->update_status();
+    if (_inbox_initialized) {
+        _inbox_initialized = false;
+        uv_close((uv_handle_t *) &_inbox_async, nullptr);
 
-        if (conn->is_stopped()) {
-            i = _connections.erase(i);
-            continue;
+        uv_os_sock_t fd;
+        while (_inbox.pop(fd)) {
+            ::close(fd);
         }
-
-        i++;
     }
 
     return ret;
 }
 
-int RsServerManager::initialize(const rs_config::ConfigServerContainer &servers) {
+std::vector<std::shared_ptr<RsServerRtmpConn>> RsRtmpServer::get_connections() {
+    std::vector<std::shared_ptr<RsServerRtmpConn>> conns;
+    for (auto &conn : _connections) {
+        if (conn != nullptr) {
+            conns.push_back(conn);
+        }
+    }
+    return conns;
+}
+
+RsServerWorker::RsServerWorker(uint32_t index) : _index(index), _loop(nullptr),
+                                                 _handles_initialized(false),
+                                                 _stop_async(uv_async_t()) {
+}
+
+RsServerWorker::~RsServerWorker() {
+    stop();
+}
+
+int RsServerWorker::initialize(const rs_config::ConfigServerContainer &servers,
+                               const DispatcherContainer &dispatchers) {
     int ret = ERROR_SUCCESS;
 
+    _loop = RsLoop::get_instance();
+
     for (auto &i : servers) {
         auto config = i.second.get();
+        if (config->get_worker_threads() <= _index) {
+            continue;
+        }
 
         std::shared_ptr<RsBaseServer> baseServer = nullptr;
         switch (config->get_type()) {
-            case rs_config::RS_SERVER_TYPE_RTMP:
-                baseServer = std::make_shared<RsRtmpServer>();
+            case rs_config::RS_SERVER_TYPE_RTMP: {
+                auto dispatcher = dispatchers.find(config->get_server_name());
+                baseServer = std::make_shared<RsRtmpServer>(
+                        _index, dispatcher != dispatchers.end() ? dispatcher->second : nullptr);
                 break;
+            }
             default:
                 rs_error(nullptr, "Sorry, we only support rtmp server now");
                 return ERROR_CONFIGURE_TYPE_OF_SERVER_NOT_SUPPORT;
@@ -111,52 +342,177 @@ int RsServerManager::initialize(const rs_config::ConfigServerContainer &servers)
         assert(baseServer != nullptr);
 
         if ((ret = baseServer->initialize(config)) != ERROR_SUCCESS) {
-            rs_error(nullptr, "initialize server failed. name=%s, type=%d, ret=%d",
-                     config->get_server_name().c_str(), config->get_type(), ret);
+            rs_error(nullptr, "initialize server failed. name=%s, type=%d, worker=%u, ret=%d",
+                     config->get_server_name().c_str(), config->get_type(), _index, ret);
             return ret;
         }
 
-        server_container[config->get_server_name()] = baseServer;
+        _servers[config->get_server_name()] = baseServer;
     }
 
-    if ((ret = uv_timer_init(uv_default_loop(), &_timer)) != 0) {
-        rs_error(nullptr, "initialize timer for servers manager failed.");
+    if ((ret = uv_async_init(_loop->get_uv_loop(), &_stop_async, on_stop)) != 0) {
+        rs_error(nullptr, "initialize stop notification for servers worker failed.");
         return ret;
     }
 
-    _timer.data = this;
+    _stop_async.data = this;
+    _handles_initialized = true;
 
-    // TODO:FIXME: use configure items to set timeout and repeat
-    if ((ret = uv_timer_start(&_timer, do_update_status, 100, 100)) != 0) {
-        rs_error(nullptr, "start timer failed.");
-        return ret;
+    rs_info(nullptr, "initialize servers worker=%u success, servers=%d", _index,
+            (int) _servers.size());
+
+    return ret;
+}
+
+int RsServerWorker::run() {
+    return uv_run(_loop->get_uv_loop(), UV_RUN_DEFAULT);
+}
+
+int RsServerWorker::start(const rs_config::ConfigServerContainer &servers,
+                          const DispatcherContainer &dispatchers) {
+    std::promise<int> initialized;
+    auto result = initialized.get_future();
+
+    _thread.reset(new std::thread(&RsServerWorker::do_thread_run, this, std::cref(servers),
+                                  std::cref(dispatchers), &initialized));
+
+    int ret = result.get();
+    if (ret != ERROR_SUCCESS) {
+        _thread->join();
+        _thread.reset();
     }
 
     return ret;
 }
 
-int RsServerManager::run() {
-    return uv_run(uv_default_loop(), UV_RUN_DEFAULT);
+void RsServerWorker::do_thread_run(const rs_config::ConfigServerContainer &servers,
+                                   const DispatcherContainer &dispatchers,
+                                   std::promise<int> *initialized) {
+    int ret = ERROR_SUCCESS;
+
+    uv_loop_t uv_loop{};
+    if ((ret = uv_loop_init(&uv_loop)) != 0) {
+        rs_error(nullptr, "initialize loop of servers worker=%u failed. ret=%d", _index, ret);
+        initialized->set_value(ret);
+        return;
+    }
+
+    {
+        RsLoop loop(&uv_loop);
+        RsLoop::set_instance(&loop);
+
+        ret = initialize(servers, dispatchers);
+        // the promise is gone once the value is set
+        initialized->set_value(ret);
+
+        if (ret == ERROR_SUCCESS) {
+            uv_run(&uv_loop, UV_RUN_DEFAULT);
+        }
+
+        do_stop();
+
+        // let the loop finish closing every handle before the owners are freed
+        uv_walk(&uv_loop, [](uv_handle_t *handle, void *arg) {
+            if (!uv_is_closing(handle)) {
+                uv_close(handle, nullptr);
+            }
+        }, nullptr);
+        uv_run(&uv_loop, UV_RUN_DEFAULT);
+
+        _servers.clear();
+        RsLoop::set_instance(nullptr);
+        _loop = nullptr;
+    }
+
+    uv_loop_close(&uv_loop);
 }
 
-void RsServerManager::stop() {
-    for (auto &i : server_container) {
+void RsServerWorker::stop() {
+    if (_thread != nullptr) {
+        uv_async_send(&_stop_async);
+        _thread->join();
+        _thread.reset();
+        return;
+    }
+
+    if (_loop != nullptr) {
+        do_stop();
+        // the loop is not running any more, let libuv finish closing the handles of
+        // the servers before they are freed
+        uv_run(_loop->get_uv_loop(), UV_RUN_NOWAIT);
+        _servers.clear();
+    }
+}
+
+void RsServerWorker::do_stop() {
+    for (auto &i : _servers) {
         i.second->dispose();
     }
 
-    server_container.clear();
+    if (_handles_initialized) {
+        _handles_initialized = false;
+        uv_close((uv_handle_t *) &_stop_async, nullptr);
+    }
 }
 
-void RsServerManager::do_update_status(uv_timer_t *timer) {
-    auto manager = (RsServerManager *) timer->data;
+void RsServerWorker::on_stop(uv_async_t *async) {
+    auto worker = (RsServerWorker *) async->data;
+    assert(worker != nullptr);
 
-    assert(manager != nullptr);
+    worker->do_stop();
+    uv_stop(worker->_loop->get_uv_loop());
+}
 
+int RsServerManager::initialize(const rs_config::ConfigServerContainer &servers) {
     int ret = ERROR_SUCCESS;
-    for (auto &i : manager->server_container) {
-        if ((ret = i.second->update_status()) != ERROR_SUCCESS) {
-            rs_error(nullptr, "update status of server=%s failed. ret=%d", i.first.c_str(), ret);
+
+    uint32_t workers = 1;
+    for (auto &i : servers) {
+        workers = std::max(workers, i.second->get_worker_threads());
+
+        if (i.second->get_listen_mode() == rs_config::RS_LISTEN_MODE_DISPATCH) {
+            _dispatchers[i.first] = std::make_shared<RsConnectionDispatcher>(
+                    i.second->get_worker_threads());
         }
     }
 
+    // worker 0 runs on the main thread, the others start their own threads
+    for (uint32_t i = 0; i < workers; i++) {
+        auto worker = std::unique_ptr<RsServerWorker>(new RsServerWorker(i));
+
+        ret = i == 0 ? worker->initialize(servers, _dispatchers)
+                     : worker->start(servers, _dispatchers);
+        if (ret != ERROR_SUCCESS) {
+            rs_error(nullptr, "initialize servers worker=%u failed. ret=%d", i, ret);
+            return ret;
+        }
+
+        _workers.push_back(std::move(worker));
+    }
+
+    rs_info(nullptr, "initialize server manager success, workers=%u", workers);
+
+    return ret;
+}
+
+int RsServerManager::run() {
+    assert(!_workers.empty());
+    return _workers[0]->run();
+}
+
+std::vector<int> RsServerManager::get_connection_counts(const std::string &server) {
+    auto dispatcher = _dispatchers.find(server);
+    if (dispatcher == _dispatchers.end()) {
+        return std::vector<int>();
+    }
+
+    return dispatcher->second->get_connection_counts();
+}
+
+void RsServerManager::stop() {
+    // the threads first, the main loop is not running any more
+    while (!_workers.empty()) {
+        _workers.back()->stop();
+        _workers.pop_back();
+    }
 }
@@ -25,7 +25,12 @@ SOFTWARE.
 #ifndef RS_MODULE_SERVER_H_
 #define RS_MODULE_SERVER_H_
 
+#include <thread>
+#include <future>
+#include <mutex>
 #include "rs_kernel_io.h"
+#include "rs_kernel_loop.h"
+#include "rs_kernel_queue.h"
 #include "rs_module_rtmp_conn.h"
 #include "rs_module_config.h"
 
@@ -40,38 +45,147 @@ public:
     virtual int initialize(rs_config::RsConfigBaseServer *config) = 0;
 
     virtual int dispose() = 0;
+};
+
+class RsRtmpServer;
+
+/**
+ * shared by the instances of one server in dispatch mode, worker 0 accepts and
+ * hands every socket to the instance with the fewest connections.
+ */
+class RsConnectionDispatcher {
+private:
+    // indexed by worker, a detached server is not posted to once detach returns
+    std::mutex _mutex;
+    std::vector<RsRtmpServer *> _servers;
+    std::vector<std::atomic<int>> _connections;
+public:
+    explicit RsConnectionDispatcher(uint32_t workers);
+
+    virtual ~RsConnectionDispatcher() = default;
+
+public:
+    void attach(uint32_t worker, RsRtmpServer *server);
+
+    void detach(uint32_t worker);
+
+    // only called by the accepting loop, the new connection is counted for the worker
+    RsRtmpServer *pick(uint32_t &worker);
+
+    // hand the socket to the server of the worker, fails if it is detached meanwhile
+    int post(uint32_t worker, uv_os_sock_t fd);
 
-    virtual int update_status() = 0;
+    void on_connection_closed(uint32_t worker);
+
+    std::vector<int> get_connection_counts();
 };
 
+using DispatcherContainer = std::map<std::string, std::shared_ptr<RsConnectionDispatcher>>;
+
 class RsRtmpServer : public RsBaseServer {
 private:
+    uint32_t _worker;
+
     std::unique_ptr<RsTCPListener> _listen_sock;
 
+    rs_config::RsConfigRTMPServer *_config;
+
+    // connections by slot, the slot of a stopped connection is reused by the next one
     std::vector<std::shared_ptr<RsServerRtmpConn>> _connections;
+    std::vector<size_t> _free_slots;
+
+    // null unless in dispatch mode
+    std::shared_ptr<RsConnectionDispatcher> _dispatcher;
+
+    // sockets dispatched from the accepting worker
+    RsMPSCQueue<uv_os_sock_t> _inbox;
+    uv_async_t _inbox_async;
+    bool _inbox_initialized;
 public:
-    RsRtmpServer();
+    RsRtmpServer(uint32_t worker, std::shared_ptr<RsConnectionDispatcher> dispatcher);
 
     ~RsRtmpServer() override;
 
 private:
     static void on_new_connection(IRsReaderWriter *io, void *param);
 
+    static void on_dispatched(uv_async_t *async);
+
+    static void on_connection_stopped(RsConnection *conn, void *param);
+
+    void add_connection(IRsReaderWriter *io);
+
+public:
+    // by the dispatcher, the socket is opened on the loop of this server
+    void post_connection(uv_os_sock_t fd);
+
 public:
     int initialize(rs_config::RsConfigBaseServer *config) override;
 
     int dispose() override;
 
-    int update_status() override;
+    // connections not stopped yet
+    size_t get_connection_count() { return _connections.size() - _free_slots.size(); }
+
+    std::vector<std::shared_ptr<RsServerRtmpConn>> get_connections();
+};
+
+using ServerContainer = std::map<std::string, std::shared_ptr<RsBaseServer>>;
+
+/**
+ * one event loop and the servers running on it.
+ * worker 0 runs on the default loop in the main thread, the others on their own
+ * thread and loop, the listeners of a server with several workers share the port
+ * by SO_REUSEPORT.
+ */
+class RsServerWorker {
+private:
+    uint32_t _index;
+    RsLoop *_loop;
+    ServerContainer _servers;
+    bool _handles_initialized;
+    uv_async_t _stop_async;
+    std::unique_ptr<std::thread> _thread;
+public:
+    explicit RsServerWorker(uint32_t index);
+
+    RsServerWorker(RsServerWorker const &) = delete;
+
+    RsServerWorker &operator=(RsServerWorker const &) = delete;
+
+    virtual ~RsServerWorker();
+
+private:
+    static void on_stop(uv_async_t *async);
+
+    void do_stop();
+
+    void do_thread_run(const rs_config::ConfigServerContainer &servers,
+                       const DispatcherContainer &dispatchers,
+                       std::promise<int> *initialized);
+
+public:
+    // create the servers which have more workers than index on the loop of current thread
+    int initialize(const rs_config::ConfigServerContainer &servers,
+                   const DispatcherContainer &dispatchers);
+
+    // run the loop of current thread until stopped
+    int run();
+
+    // create a thread with its own loop, initialize and run the servers there
+    int start(const rs_config::ConfigServerContainer &servers,
+              const DispatcherContainer &dispatchers);
+
+    // stop the servers, wait for the thread if any
+    void stop();
 };
 
 class RsServerManager {
 private:
-    using ServerContainer = std::map<std::string, std::shared_ptr<RsBaseServer>>;
-    ServerContainer server_container;
-    uv_timer_t _timer;
+    DispatcherContainer _dispatchers;
+    std::vector<std::unique_ptr<RsServerWorker>> _workers;
 public:
-    RsServerManager() : _timer(uv_timer_t()) {};
+    RsServerManager() = default;
 
     ~RsServerManager() { stop(); };
 
@@ -82,8 +196,8 @@ public:
 
     void stop();
 
-public:
-    static void do_update_status(uv_timer_t *timer);
+    // the connections of each worker, empty unless the server is in dispatch mode
+    std::vector<int> get_connection_counts(const std::string &server);
 };
 
 #endif
@@ -0,0 +1,444 @@
+/*
+MIT License
+
+Copyright (c) 2016 ME_Kun_Han
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <cstring>
+#include "rs_module_source.h"
+#include "rs_module_log.h"
+
+RsRtmpConsumer::RsRtmpConsumer(consumer_cb cb, void *param, uint32_t capacity)
+        : _thread_id(std::this_thread::get_id()), _check_scheduled(false), _start_pending(false),
+          _queue(capacity), _notified(false), _dropping(false), _dropped(0), _cb(std::move(cb)), _param(param),
+          _merge_window(0), _merge_messages(0) {
+    _merge_timer.set_callback(on_merge_timeout, this);
+    _loop = RsLoop::get_instance();
+
+    _async = new uv_async_t();
+    uv_async_init(_loop->get_uv_loop(), _async, on_async);
+    _async->data = this;
+}
+
+RsRtmpConsumer::~RsRtmpConsumer() {
+    if (_check_scheduled) {
+        _loop->cancel_check(this);
+    }
+
+    // freed once libuv closed it
+    _async->data = nullptr;
+    uv_close((uv_handle_t *) _async, [](uv_handle_t *handle) {
+        delete (uv_async_t *) handle;
+    });
+}
+
+void RsRtmpConsumer::set_merged_write(uint32_t window_ms, uint32_t messages) {
+    _merge_window = window_ms;
+    _merge_messages = messages;
+}
+
+void RsRtmpConsumer::on_async(uv_async_t *async) {
+    auto pt = (RsRtmpConsumer *) async->data;
+    if (pt != nullptr) {
+        pt->on_wakeup();
+    }
+}
+
+void RsRtmpConsumer::on_loop_check() {
+    _check_scheduled = false;
+    on_wakeup();
+}
+
+void RsRtmpConsumer::on_merge_timeout(void *param) {
+    auto pt = (RsRtmpConsumer *) param;
+    pt->call_player();
+}
+
+bool RsRtmpConsumer::is_merge_done() {
+    if (_merge_messages > 0 && _queue.size() >= _merge_messages) {
+        return true;
+    }
+
+    return _start_pending;
+}
+
+void RsRtmpConsumer::on_wakeup() {
+    if (_merge_window > 0 && !is_merge_done()) {
+        // the first message of the window waits the longest, the rest do not wake up again
+        if (!_merge_timer.is_started()) {
+            _merge_timer.start(_merge_window);
+        }
+        return;
+    }
+
+    _merge_timer.cancel();
+    call_player();
+}
+
+void RsRtmpConsumer::call_player() {
+    if (_cb) {
+        _cb(_param);
+    }
+}
+
+void RsRtmpConsumer::notify() {
+    if (std::this_thread::get_id() != _thread_id) {
+        uv_async_send(_async);
+        return;
+    }
+
+    if (!_check_scheduled) {
+        _check_scheduled = true;
+        _loop->schedule_check(this);
+    }
+}
+
+void RsRtmpConsumer::enqueue(const std::shared_ptr<RsRtmpSharedMessage> &msg) {
+    auto &m = msg->get_message();
+    bool is_video = m.type_id == RS_RTMP_MSG_VIDEO;
+    bool is_keyframe = rs_rtmp_is_video_keyframe(m) && !rs_rtmp_is_video_sequence_header(m);
+
+    // the frames after a dropped one can not be decoded until the next keyframe
+    if (_dropping && ((is_video && !rs_rtmp_is_video_keyframe(m)) ||
+                      (!is_video && _queue.size() > _queue.capacity() / 2))) {
+        _dropped++;
+        return;
+    }
+
+    if (!_queue.push(msg)) {
+        if (!_dropping) {
+            rs_warn(nullptr, "queue of player is full of %u messages, drop until next keyframe",
+                    (uint32_t) _queue.capacity());
+        }
+        _dropping = true;
+        _dropped++;
+        return;
+    }
+
+    if (is_keyframe) {
+        _dropping = false;
+    }
+
+    // the window is full before its time
+    bool full_window = _merge_window > 0 && _queue.size() == _merge_messages;
+
+    if (!_notified.exchange(true) || full_window) {
+        notify();
+    }
+}
+
+bool RsRtmpConsumer::dequeue(std::shared_ptr<RsRtmpSharedMessage> &msg) {
+    if (!_queue.pop(msg)) {
+        // drained, the pushes from now on wake the player up again, and the one
+        // which saw the flag still set is taken here
+        _notified.exchange(false);
+        if (!_queue.pop(msg)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void RsRtmpConsumer::set_start_frames(std::shared_ptr<RsRtmpStartFrames> frames) {
+    {
+        std::lock_guard<std::mutex> lock(_start_mutex);
+        _start_frames = std::move(frames);
+        _start_pending = _start_frames != nullptr;
+    }
+
+    // not delayed by merged write
+    _notified.exchange(true);
+    notify();
+}
+
+std::shared_ptr<RsRtmpStartFrames> RsRtmpConsumer::take_start_frames() {
+    // the setter wakes the player up again after it is set
+    if (!_start_pending) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(_start_mutex);
+    _start_pending = false;
+    return std::move(_start_frames);
+}
+
+RsRtmpGopCache::RsRtmpGopCache() : _max_duration(rs_config::DEFAULT_GOP_CACHE_MAX_DURATION),
+                                   _max_bytes(rs_config::DEFAULT_GOP_CACHE_MAX_BYTES),
+                                   _frame_chunk_size(rs_config::DEFAULT_OUT_CHUNK_SIZE), _gop_bytes(0) {
+}
+
+void RsRtmpGopCache::set_limits(uint32_t max_duration, uint32_t max_bytes) {
+    _max_duration = max_duration;
+    _max_bytes = max_bytes;
+}
+
+void RsRtmpGopCache::set_frame_chunk_size(uint32_t chunk_size) {
+    if (_frame_chunk_size != chunk_size) {
+        _frame_chunk_size = chunk_size;
+        update_start_frames();
+    }
+}
+
+void RsRtmpGopCache::update_start_frames() {
+    auto frames = std::make_shared<RsRtmpStartFrames>();
+    frames->chunk_size = _frame_chunk_size;
+
+    // a new encoder starts every cs_id by type 0
+    RsRtmpChunkEncoder encoder;
+    encoder.set_chunk_size(_frame_chunk_size);
+
+    std::vector<RsSharedSlice> slices;
+    size_t size = 0;
+    for (auto msg : {_metadata, _video_sequence_header, _audio_sequence_header}) {
+        if (msg != nullptr) {
+            size += encoder.encode(*msg, slices);
+            frames->messages.push_back(msg);
+        }
+    }
+
+    if (frames->messages.empty()) {
+        _start_frames.reset();
+        return;
+    }
+
+    // a few hundred bytes copied once per publish, rather than encoded for each player
+    auto block = RsLoop::get_instance()->get_buffer_pool()->allocate(size);
+    char *p = block.get();
+    for (auto &slice : slices) {
+        memcpy(p, slice.data(), slice.size());
+        p += slice.size();
+    }
+    frames->frames = RsSharedSlice(block, size);
+
+    _start_frames = frames;
+}
+
+void RsRtmpGopCache::cache(const std::shared_ptr<RsRtmpSharedMessage> &msg) {
+    auto &m = msg->get_message();
+
+    // the cue points and the rest of data are only for the players at the time
+    if (m.type_id == RS_RTMP_MSG_AMF0_DATA || m.type_id == RS_RTMP_MSG_AMF3_DATA) {
+        if (rs_rtmp_get_data_name(m) == "onMetaData") {
+            _metadata = msg;
+            update_start_frames();
+        }
+        return;
+    }
+
+    if (rs_rtmp_is_video_sequence_header(m)) {
+        _video_sequence_header = msg;
+        update_start_frames();
+        return;
+    }
+
+    if (rs_rtmp_is_audio_sequence_header(m)) {
+        _audio_sequence_header = msg;
+        update_start_frames();
+        return;
+    }
+
+    if (_max_duration == 0 || _max_bytes == 0) {
+        return;
+    }
+
+    // a new gop replaces the last one
+    if (rs_rtmp_is_video_keyframe(m)) {
+        clear_gop();
+    } else if (_gop.empty()) {
+        return;
+    }
+
+    _gop.push_back(msg);
+    _gop_bytes += m.payload.size();
+
+    // too long to be worth the burst, wait for the next keyframe
+    auto duration = m.timestamp - _gop.front()->get_message().timestamp;
+    if (duration > _max_duration || _gop_bytes > _max_bytes) {
+        rs_warn(nullptr, "drop gop cache of %u messages, %u bytes in %ums", (uint32_t) _gop.size(),
+                (uint32_t) _gop_bytes, duration);
+        clear_gop();
+    }
+}
+
+void RsRtmpGopCache::dump(RsRtmpConsumer *consumer) {
+    if (_start_frames != nullptr) {
+        consumer->set_start_frames(_start_frames);
+    }
+
+    for (auto &msg : _gop) {
+        consumer->enqueue(msg);
+    }
+}
+
+void RsRtmpGopCache::clear_gop() {
+    _gop.clear();
+    _gop_bytes = 0;
+}
+
+void RsRtmpGopCache::clear() {
+    _metadata.reset();
+    _video_sequence_header.reset();
+    _audio_sequence_header.reset();
+    _start_frames.reset();
+    clear_gop();
+}
+
+RsRtmpSource::RsRtmpSource(std::string key) : _key(std::move(key)), _publishing(false) {
+}
+
+bool RsRtmpSource::on_publish() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_publishing) {
+        return false;
+    }
+
+    _publishing = true;
+    return true;
+}
+
+void RsRtmpSource::set_gop_cache(uint32_t max_duration, uint32_t max_bytes) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _gop_cache.set_limits(max_duration, max_bytes);
+}
+
+void RsRtmpSource::set_frame_chunk_size(uint32_t chunk_size) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _gop_cache.set_frame_chunk_size(chunk_size);
+}
+
+void RsRtmpSource::on_unpublish() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _publishing = false;
+
+    // the next publisher may change the codecs
+    _gop_cache.clear();
+}
+
+bool RsRtmpSource::is_publishing() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _publishing;
+}
+
+void RsRtmpSource::on_message(const RsRtmpMessage &msg) {
+    RsRtmpMessage out = msg;
+    out.stream_id = RS_RTMP_STREAM_ID;
+    rs_rtmp_remove_set_data_frame(out);
+    switch (msg.type_id) {
+        case RS_RTMP_MSG_AUDIO:
+            out.cs_id = RS_RTMP_CSID_AUDIO;
+            break;
+        case RS_RTMP_MSG_VIDEO:
+            out.cs_id = RS_RTMP_CSID_VIDEO;
+            break;
+        default:
+            out.cs_id = RS_RTMP_CSID_DATA;
+            break;
+    }
+
+    auto shared = std::make_shared<RsRtmpSharedMessage>(out);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // the chunks of the out chunk size are encoded here once, the players of another
+    // chunk size encode their own on first use
+    shared->frame(_gop_cache.get_frame_chunk_size(), RsLoop::get_instance()->get_buffer_pool().get());
+
+    for (auto consumer : _consumers) {
+        consumer->enqueue(shared);
+    }
+
+    _gop_cache.cache(shared);
+}
+
+void RsRtmpSource::attach(RsRtmpConsumer *consumer) {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // the burst goes before any new message
+    _gop_cache.dump(consumer);
+    _consumers.push_back(consumer);
+}
+
+void RsRtmpSource::detach(RsRtmpConsumer *consumer) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _consumers.erase(std::remove(_consumers.begin(), _consumers.end(), consumer), _consumers.end());
+}
+
+size_t RsRtmpSource::get_consumer_count() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _consumers.size();
+}
+
+size_t RsRtmpSource::get_gop_count() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _gop_cache.get_gop_count();
+}
+
+RsRtmpSourceManager *RsRtmpSourceManager::get_instance() {
+    // never freed, the sources may be released by any thread until exit
+    static auto instance = new RsRtmpSourceManager();
+    return instance;
+}
+
+void RsRtmpSourceManager::remove(RsRtmpSource *source) {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // the key may be taken by a new source already
+    auto it = _sources.find(source->get_key());
+    if (it != _sources.end() && it->second.expired()) {
+        _sources.erase(it);
+    }
+}
+
+std::shared_ptr<RsRtmpSource> RsRtmpSourceManager::fetch_or_create(const std::string &key) {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto &entry = _sources[key];
+    auto source = entry.lock();
+    if (source != nullptr) {
+        return source;
+    }
+
+    source.reset(new RsRtmpSource(key), [this](RsRtmpSource *p) {
+        remove(p);
+        delete p;
+    });
+    entry = source;
+
+    rs_info(nullptr, "create source %s", key.c_str());
+    return source;
+}
+
+std::shared_ptr<RsRtmpSource> RsRtmpSourceManager::fetch(const std::string &key) {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto it = _sources.find(key);
+    return it == _sources.end() ? nullptr : it->second.lock();
+}
+
+size_t RsRtmpSourceManager::size() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _sources.size();
+}
+
+std::string rs_rtmp_get_source_key(const std::string &app, const std::string &stream) {
+    return app.substr(0, app.find('?')) + "/" + stream.substr(0, stream.find('?'));
+}
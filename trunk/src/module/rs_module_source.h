@@ -0,0 +1,284 @@
+/*
+MIT License
+
+Copyright (c) 2016 ME_Kun_Han
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef RS_MODULE_SOURCE_H_
+#define RS_MODULE_SOURCE_H_
+
+#include <uv.h>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include "rs_common.h"
+#include "rs_kernel_loop.h"
+#include "rs_kernel_queue.h"
+#include "rs_protocol_rtmp.h"
+#include "rs_module_config.h"
+
+using consumer_cb = std::function<void(void *param)>;
+
+/**
+ * the metadata and sequence headers chunked once for one chunk size, in one block
+ * with type 0 headers, so that a joining player of that chunk size is sent one
+ * slice instead of encoding them again.
+ */
+struct RsRtmpStartFrames {
+    uint32_t chunk_size;
+    RsSharedSlice frames;
+    // in the order framed, to tell the encoder of player or to be sent one by one
+    std::vector<std::shared_ptr<RsRtmpSharedMessage>> messages;
+};
+
+/**
+ * the messages of a source waiting for one player, created and drained on the
+ * loop of the player. the source pushes from the loop of the publisher into a
+ * lock free ring, and the player is woken up once for all pushed until it drains
+ * the ring, at the end of the iteration on the same loop, or by an async on
+ * another one. a player which stops before drained, as it is not writable,
+ * resumes by itself.
+ * in merged write, the player is woken up once the window since the first message
+ * passed or enough messages are queued, to send them by one write.
+ * when the ring is full the player falls behind, the messages are dropped until
+ * the next keyframe, and the rest until half of the ring is drained.
+ */
+class RsRtmpConsumer : public IRsLoopCheck {
+private:
+    RsLoop *_loop;
+    std::thread::id _thread_id;
+    uv_async_t *_async;
+    bool _check_scheduled;
+
+    // set and taken once for each player, not on the path of media
+    std::mutex _start_mutex;
+    std::shared_ptr<RsRtmpStartFrames> _start_frames;
+    // set and cleared with the frames, tested by each wakeup without the lock
+    std::atomic<bool> _start_pending;
+
+    // the source pushes one message at a time under its lock
+    RsSPSCQueue<std::shared_ptr<RsRtmpSharedMessage>> _queue;
+    // pushed since the player drained the ring
+    std::atomic<bool> _notified;
+
+    // only by the producer
+    bool _dropping;
+    std::atomic<uint64_t> _dropped;
+
+    consumer_cb _cb;
+    void *_param;
+
+    // 0 for no merged write
+    uint32_t _merge_window;
+    // 0 for no limit of messages in the window
+    uint32_t _merge_messages;
+    RsTimer _merge_timer;
+public:
+    RsRtmpConsumer(consumer_cb cb, void *param,
+                   uint32_t capacity = rs_config::DEFAULT_CONSUMER_QUEUE_SIZE);
+
+    RsRtmpConsumer(RsRtmpConsumer const &) = delete;
+
+    RsRtmpConsumer &operator=(RsRtmpConsumer const &) = delete;
+
+    // on the loop of the player, after detached from the source
+    ~RsRtmpConsumer() override;
+
+private:
+    static void on_async(uv_async_t *async);
+
+    static void on_merge_timeout(void *param);
+
+    void notify();
+
+    // the player is called now, or once the merge window passed
+    void on_wakeup();
+
+    // the start frames are not delayed, nor a full window of messages
+    bool is_merge_done();
+
+    void call_player();
+
+public:
+    // before attached to the source
+    void set_merged_write(uint32_t window_ms, uint32_t messages);
+
+    // by one producer at a time
+    void enqueue(const std::shared_ptr<RsRtmpSharedMessage> &msg);
+
+    // false when nothing is queued, the next push wakes up the player then
+    bool dequeue(std::shared_ptr<RsRtmpSharedMessage> &msg);
+
+    // thread safe, sent before the messages queued
+    void set_start_frames(std::shared_ptr<RsRtmpStartFrames> frames);
+
+    // null if none or taken already
+    std::shared_ptr<RsRtmpStartFrames> take_start_frames();
+
+    size_t size() { return _queue.size(); }
+
+    // the messages not queued as the ring was full
+    uint64_t get_dropped_count() { return _dropped; }
+
+// implement IRsLoopCheck
+public:
+    void on_loop_check() override;
+};
+
+/**
+ * what a new player needs to start decoding at once: the latest metadata and
+ * sequence headers, and the messages from the last video keyframe on.
+ * the messages are the references shared with the players, nothing is copied.
+ */
+class RsRtmpGopCache {
+private:
+    // 0 for no gop, the sequence headers and metadata are kept anyway
+    uint32_t _max_duration;
+    uint32_t _max_bytes;
+
+    std::shared_ptr<RsRtmpSharedMessage> _metadata;
+    std::shared_ptr<RsRtmpSharedMessage> _video_sequence_header;
+    std::shared_ptr<RsRtmpSharedMessage> _audio_sequence_header;
+
+    // rebuilt when any of above changes
+    uint32_t _frame_chunk_size;
+    std::shared_ptr<RsRtmpStartFrames> _start_frames;
+
+    // starts with a keyframe, or empty until the next one
+    std::deque<std::shared_ptr<RsRtmpSharedMessage>> _gop;
+    size_t _gop_bytes;
+public:
+    RsRtmpGopCache();
+
+    ~RsRtmpGopCache() = default;
+
+private:
+    void clear_gop();
+
+    void update_start_frames();
+
+public:
+    void set_limits(uint32_t max_duration, uint32_t max_bytes);
+
+    // the chunk size of the start frames, the out chunk size of the server
+    void set_frame_chunk_size(uint32_t chunk_size);
+
+    uint32_t get_frame_chunk_size() { return _frame_chunk_size; }
+
+    void cache(const std::shared_ptr<RsRtmpSharedMessage> &msg);
+
+    // the burst for a new player, in the order to be sent
+    void dump(RsRtmpConsumer *consumer);
+
+    // all, when unpublished
+    void clear();
+
+    size_t get_gop_count() { return _gop.size(); }
+
+    size_t get_gop_bytes() { return _gop_bytes; }
+};
+
+/**
+ * one published stream, "app/stream", and the players attached to it.
+ * each message of the publisher is wrapped once and the same reference is
+ * queued to every consumer, the payload is never copied.
+ */
+class RsRtmpSource {
+private:
+    std::string _key;
+
+    // the publisher and the players may be on different loops
+    std::mutex _mutex;
+    bool _publishing;
+    std::vector<RsRtmpConsumer *> _consumers;
+    RsRtmpGopCache _gop_cache;
+public:
+    explicit RsRtmpSource(std::string key);
+
+    ~RsRtmpSource() = default;
+
+public:
+    const std::string &get_key() { return _key; }
+
+    // false when published by another connection
+    bool on_publish();
+
+    // the limits of the publisher, see RsRtmpGopCache
+    void set_gop_cache(uint32_t max_duration, uint32_t max_bytes);
+
+    // the players of the out chunk size of the publisher get the start frames and
+    // the chunks of every message as is
+    void set_frame_chunk_size(uint32_t chunk_size);
+
+    void on_unpublish();
+
+    bool is_publishing();
+
+    // from the publisher, sent as the stream of RS_RTMP_STREAM_ID of the players,
+    // the @setDataFrame of metadata is removed
+    void on_message(const RsRtmpMessage &msg);
+
+    // the consumer is not owned, it must be detached before freed.
+    // the gop cache is queued to it first
+    void attach(RsRtmpConsumer *consumer);
+
+    void detach(RsRtmpConsumer *consumer);
+
+    size_t get_consumer_count();
+
+    // the messages of gop cached
+    size_t get_gop_count();
+};
+
+/**
+ * the sources by key of all loops, a source lives while its publisher or any
+ * player holds it.
+ */
+class RsRtmpSourceManager {
+private:
+    std::mutex _mutex;
+    std::unordered_map<std::string, std::weak_ptr<RsRtmpSource>> _sources;
+public:
+    RsRtmpSourceManager() = default;
+
+    ~RsRtmpSourceManager() = default;
+
+private:
+    void remove(RsRtmpSource *source);
+
+public:
+    static RsRtmpSourceManager *get_instance();
+
+    // the source of the key, created if none
+    std::shared_ptr<RsRtmpSource> fetch_or_create(const std::string &key);
+
+    // null if none
+    std::shared_ptr<RsRtmpSource> fetch(const std::string &key);
+
+    size_t size();
+};
+
+// the key of the source from app and stream name, the query strings are removed
+std::string rs_rtmp_get_source_key(const std::string &app, const std::string &stream);
+
+#endif
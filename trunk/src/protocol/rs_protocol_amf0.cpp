@@ -106,14 +106,14 @@ bool RsAmf0Package::is_typed_object() {
 
 RsAmf0Package *RsAmf0Package::create_package(IRsReaderWriter *reader) {
     int ret = ERROR_SUCCESS;
-    string buf;
+    RsSlice buf;
     // read the marker
     if ((ret = reader->read(buf, 1)) != ERROR_SUCCESS) {
         cout << "read marker failed. ret=" << ret << endl;
         return nullptr;
     }
 
-    switch (buf[0]) {
+    switch (buf.data[0]) {
         case AMF0_MARKER::AMF0_NUMBER: {
             RsAmf0Number *value = new RsAmf0Number();
             if ((ret = value->initialize(reader)) != ERROR_SUCCESS) {
@@ -149,6 +149,28 @@ RsAmf0Package *RsAmf0Package::create_package(IRsReaderWriter *reader) {
                 return nullptr;
             }
             return value;
+        }
+        case AMF0_MARKER::AMF0_NULL:
+            return new RsAmf0Null();
+        case AMF0_MARKER::AMF0_UNDEFINED:
+            return new RsAmf0Undefined();
+        case AMF0_MARKER::AMF0_ECMA_ARRAY: {
+            RsAmf0ECMAArray *value = new RsAmf0ECMAArray();
+            if ((ret = value->initialize(reader)) != ERROR_SUCCESS) {
+                cout << "initialize amf0 ecma array failed. ret=" << ret << endl;
+                rs_free_p(value);
+                return nullptr;
+            }
+            return value;
+        }
+        case AMF0_MARKER::AMF0_STRICT_ARRAY: {
+            RsAmf0StrictArray *value = new RsAmf0StrictArray();
+            if ((ret = value->initialize(reader)) != ERROR_SUCCESS) {
+                cout << "initialize amf0 strict array failed. ret=" << ret << endl;
+                rs_free_p(value);
+                return nullptr;
+            }
+            return value;
         }
             // TODO:FIXME: implement other type of amf0 package
         default:
@@ -157,7 +179,9 @@ RsAmf0Package *RsAmf0Package::create_package(IRsReaderWriter *reader) {
 }
 
 string RsAmf0Package::dump() {
-    return encode();
+    RsBufferLittleEndian buf;
+    encode(buf);
+    return buf.dump();
 }
 
 RsAmf0Number::RsAmf0Number() {
@@ -173,22 +197,20 @@ RsAmf0Number::~RsAmf0Number() {
 
 }
 
-string RsAmf0Number::encode() {
-    RsBufferLittleEndian buf;
+void RsAmf0Number::encode(RsBufferLittleEndian &buf) {
     buf.write_1_byte(marker);
-    buf.write_8_byte(static_cast<uint64_t>(value));
-    return buf.dump();
+    buf.write<double>(value);
 }
 
 int RsAmf0Number::initialize(IRsReaderWriter *reader) {
     int ret = ERROR_SUCCESS;
-    string buf;
+    RsSlice buf;
 
     if ((ret = reader->read(buf, 8)) != ERROR_SUCCESS) {
         cout << "read number for amf0 number failed. ret=" << ret << endl;
         return ret;
     }
-    value = static_cast<double>(RsBufferLittleEndian::convert_8bytes_into_uint64(buf));
+    value = rs_read_be<double>(buf.data);
     return ret;
 }
 
@@ -205,16 +227,14 @@ RsAmf0Boolean::~RsAmf0Boolean() {
 
 }
 
-string RsAmf0Boolean::encode() {
-    RsBufferLittleEndian buf;
+void RsAmf0Boolean::encode(RsBufferLittleEndian &buf) {
     buf.write_1_byte(marker);
     buf.write_1_byte(uint8_t(value));
-    return buf.dump();
 }
 
 int RsAmf0Boolean::initialize(IRsReaderWriter *reader) {
     int ret = ERROR_SUCCESS;
-    string buf;
+    RsSlice buf;
 
     // read value
     if ((ret = reader->read(buf, 1)) != ERROR_SUCCESS) {
@@ -222,12 +242,12 @@ int RsAmf0Boolean::initialize(IRsReaderWriter *reader) {
         return ret;
     }
 
-    value = (uint8_t) buf[0];
+    value = (uint8_t) buf.data[0];
     return ret;
 }
 
 RsAmf0String::RsAmf0String() {
-
+    marker = AMF0_MARKER::AMF0_STRING;
 }
 
 RsAmf0String::RsAmf0String(string val) {
@@ -239,25 +259,22 @@ RsAmf0String::~RsAmf0String() {
 
 }
 
-string RsAmf0String::encode() {
-    RsBufferLittleEndian buf;
+void RsAmf0String::encode(RsBufferLittleEndian &buf) {
     buf.write_1_byte(marker);
     buf.write_2_byte((uint16_t) value.size());
-    buf.write_bytes(value);
-    return buf.dump();
+    buf.write_bytes(value.data(), (int) value.size());
 }
 
 int RsAmf0String::initialize(IRsReaderWriter *reader) {
     int ret = ERROR_SUCCESS;
-    string buf;
+    RsSlice buf;
 
     // read size
     if ((ret = reader->read(buf, 2)) != ERROR_SUCCESS) {
         cout << "read size of string for amf0 string failed. ret=" << ret << endl;
         return ret;
     }
-    size = RsBufferLittleEndian::convert_2bytes_into_uint16(buf);
-    buf.clear();
+    size = RsBufferLittleEndian::convert_2bytes_into_uint16(buf.data);
 
     // read string
     if ((ret = reader->read(buf, size)) != ERROR_SUCCESS) {
@@ -265,7 +282,7 @@ int RsAmf0String::initialize(IRsReaderWriter *reader) {
         return ret;
     }
 
-    value = buf;
+    value.assign(buf.data, buf.size);
     return ret;
 }
 
@@ -298,7 +315,7 @@ RsAmf0Package *RsAmf0ObjectProperty::get(std::string key) {
 }
 
 RsAmf0Package *RsAmf0ObjectProperty::get(int index) {
-    if (index > properties.size()) {
+    if (index < 0 || (size_t) index >= properties.size()) {
         cout << "the index is beyound the size of properties" << endl;
         return nullptr;
     }
@@ -308,7 +325,7 @@ RsAmf0Package *RsAmf0ObjectProperty::get(int index) {
 
 int RsAmf0ObjectProperty::initialize(IRsReaderWriter *reader) {
     int ret = ERROR_SUCCESS;
-    string buf;
+    RsSlice buf;
 
     while (1) {
         // read size of key
@@ -316,8 +333,7 @@ int RsAmf0ObjectProperty::initialize(IRsReaderWriter *reader) {
             cout << "read size of key failed. ret=" << ret << endl;
             return ret;
         }
-        uint16_t size = RsBufferLittleEndian::convert_2bytes_into_uint16(buf);
-        buf.clear();
+        uint16_t size = RsBufferLittleEndian::convert_2bytes_into_uint16(buf.data);
 
         // end of object
         if (size == 0) {
@@ -325,10 +341,11 @@ int RsAmf0ObjectProperty::initialize(IRsReaderWriter *reader) {
                 cout << "read end of object failed. ret=" << ret << endl;
                 return ret;
             }
-            if (buf[0] != AMF0_MARKER::AMF0_OBJECT_END) {
+            if (buf.data[0] != AMF0_MARKER::AMF0_OBJECT_END) {
                 ret = ERROR_RTMP_PROTOCOL_AMF0_DECODE_ERROR;
                 return ret;
             }
+            return ret;
         }
 
         // read key
@@ -336,8 +353,7 @@ int RsAmf0ObjectProperty::initialize(IRsReaderWriter *reader) {
             cout << "read key of object failed. ret=" << ret << endl;
             return ret;
         }
-        string key = buf;
-        buf.clear();
+        string key = buf.to_string();
 
         // read value
         RsAmf0Package *value = RsAmf0Package::create_package(reader);
@@ -355,18 +371,15 @@ uint32_t RsAmf0ObjectProperty::count() {
     return static_cast<uint32_t>(properties.size());
 }
 
-string RsAmf0ObjectProperty::dump() {
-    RsBufferLittleEndian buf;
-    for (auto i : properties) {
+void RsAmf0ObjectProperty::encode(RsBufferLittleEndian &buf) {
+    for (auto &i : properties) {
         buf.write_2_byte((uint16_t) i.first.length());
-        buf.write_bytes(i.first);
-        buf.write_bytes(i.second->dump());
+        buf.write_bytes(i.first.data(), (int) i.first.length());
+        i.second->encode(buf);
     }
 
     buf.write_2_byte(0);
     buf.write_1_byte(AMF0_MARKER::AMF0_OBJECT_END);
-
-    return buf.dump();
 }
 
 RsAmf0Object::RsAmf0Object() {
@@ -389,11 +402,9 @@ RsAmf0Package *RsAmf0Object::get(int index) {
     return property.get(index);
 }
 
-string RsAmf0Object::encode() {
-    RsBufferLittleEndian buf;
+void RsAmf0Object::encode(RsBufferLittleEndian &buf) {
     buf.write_1_byte(marker);
-    buf.write_bytes(property.dump());
-    return buf.dump();
+    property.encode(buf);
 }
 
 int RsAmf0Object::initialize(IRsReaderWriter *reader) {
@@ -408,12 +419,8 @@ RsAmf0Null::~RsAmf0Null() {
 
 }
 
-string RsAmf0Null::encode() {
-    RsBufferLittleEndian rs_buf;
-
+void RsAmf0Null::encode(RsBufferLittleEndian &rs_buf) {
     rs_buf.write_1_byte(marker);
-
-    return rs_buf.dump();
 }
 
 int RsAmf0Null::initialize(IRsReaderWriter *reader) {
@@ -428,12 +435,8 @@ RsAmf0Undefined::~RsAmf0Undefined() {
 
 }
 
-string RsAmf0Undefined::encode() {
-    RsBufferLittleEndian rs_buf;
-
+void RsAmf0Undefined::encode(RsBufferLittleEndian &rs_buf) {
     rs_buf.write_1_byte(marker);
-
-    return rs_buf.dump();
 }
 
 int RsAmf0Undefined::initialize(IRsReaderWriter *reader) {
@@ -453,29 +456,25 @@ RsAmf0Reference::~RsAmf0Reference() {
 
 }
 
-string RsAmf0Reference::encode() {
-    RsBufferLittleEndian rs_buf;
-
+void RsAmf0Reference::encode(RsBufferLittleEndian &rs_buf) {
     rs_buf.write_1_byte(marker);
     rs_buf.write_2_byte(reference);
-
-    return rs_buf.dump();
 }
 
 int RsAmf0Reference::initialize(IRsReaderWriter *reader) {
     int ret = ERROR_SUCCESS;
-    string buf;
+    RsSlice buf;
 
     if ((ret = reader->read(buf, 2)) != ERROR_SUCCESS) {
         cout << "reade reference for amf0 reference failed. ret=" << ret << endl;
         return ret;
     }
-    reference = RsBufferLittleEndian::convert_2bytes_into_uint16(buf);
+    reference = RsBufferLittleEndian::convert_2bytes_into_uint16(buf.data);
 
     return ret;
 }
 
-RsAmf0ECMAArray::RsAmf0ECMAArray() {
+RsAmf0ECMAArray::RsAmf0ECMAArray() : count(0) {
     marker = AMF0_MARKER::AMF0_ECMA_ARRAY;
 }
 
@@ -495,31 +494,28 @@ RsAmf0Package *RsAmf0ECMAArray::get(int index) {
     return properties.get(index);
 }
 
-string RsAmf0ECMAArray::encode() {
+void RsAmf0ECMAArray::encode(RsBufferLittleEndian &rs_buf) {
     count = properties.count();
 
-    RsBufferLittleEndian rs_buf;
-
     rs_buf.write_1_byte(marker);
     rs_buf.write_4_byte(count);
-    rs_buf.write_bytes(properties.dump());
-
-    return rs_buf.dump();
+    properties.encode(rs_buf);
 }
 
 int RsAmf0ECMAArray::initialize(IRsReaderWriter *reader) {
     int ret = ERROR_SUCCESS;
-    string buf;
+    RsSlice buf;
 
     if ((ret = reader->read(buf, 4)) != ERROR_SUCCESS) {
         cout << "read size for amf0 ecma array failed. ret=" << ret << endl;
         return ret;
     }
+    count = RsBufferLittleEndian::convert_4bytes_into_uint32(buf.data);
 
     return properties.initialize(reader);
 }
 
-RsAmf0StrictArray::RsAmf0StrictArray() {
+RsAmf0StrictArray::RsAmf0StrictArray() : count(0) {
     marker = AMF0_MARKER::AMF0_STRICT_ARRAY;
 }
 
@@ -537,30 +533,27 @@ RsAmf0Package *RsAmf0StrictArray::get(int index) {
     return array[index].get();
 }
 
-string RsAmf0StrictArray::encode() {
+void RsAmf0StrictArray::encode(RsBufferLittleEndian &rs_buf) {
     count = static_cast<uint32_t>(array.size());
-    RsBufferLittleEndian rs_buf;
 
     rs_buf.write_1_byte(marker);
     rs_buf.write_4_byte(count);
 
-    for (auto i : array) {
-        rs_buf.write_bytes(i->dump());
+    for (auto &i : array) {
+        i->encode(rs_buf);
     }
-
-    return rs_buf.dump();
 }
 
 int RsAmf0StrictArray::initialize(IRsReaderWriter *reader) {
     int ret = 0;
-    string buf;
+    RsSlice buf;
     array.clear();
 
     if ((ret = reader->read(buf, 4)) != ERROR_SUCCESS) {
         cout << "read size of strict array failed. ret=" << ret << endl;
         return ret;
     }
-    count = RsBufferLittleEndian::convert_4bytes_into_uint32(buf);
+    count = RsBufferLittleEndian::convert_4bytes_into_uint32(buf.data);
 
     for (uint32_t i = 0; i < count; i++) {
         RsAmf0Package *pkg = RsAmf0Package::create_package(reader);
@@ -26,6 +26,7 @@ SOFTWARE.
 #define RS_PROTOCOL_AMF0_H_
 
 #include "rs_kernel_io.h"
+#include "rs_kernel_buffer.h"
 #include "rs_common.h"
 
 namespace AMF0_MARKER {
@@ -91,8 +92,9 @@ public:
 
     bool is_typed_object();
 
-protected:
-    virtual std::string encode() = 0;
+public:
+    // append the encoded package to buf
+    virtual void encode(RsBufferLittleEndian &buf) = 0;
 
 public:
     virtual int initialize(IRsReaderWriter *reader) = 0;
@@ -113,8 +115,8 @@ public:
 
     virtual ~RsAmf0Number();
 
-protected:
-    std::string encode();
+public:
+    void encode(RsBufferLittleEndian &buf);
 
 public:
     int initialize(IRsReaderWriter *reader);
@@ -130,8 +132,8 @@ public:
 
     virtual ~RsAmf0Boolean();
 
-protected:
-    std::string encode();
+public:
+    void encode(RsBufferLittleEndian &buf);
 
 public:
     int initialize(IRsReaderWriter *reader);
@@ -148,8 +150,8 @@ public:
 
     virtual ~RsAmf0String();
 
-protected:
-    std::string encode();
+public:
+    void encode(RsBufferLittleEndian &buf);
 
 public:
     int initialize(IRsReaderWriter *reader);
@@ -177,7 +179,7 @@ public:
 
     uint32_t count();
 
-    std::string dump();
+    void encode(RsBufferLittleEndian &buf);
 };
 
 class RsAmf0Object : public RsAmf0Package {
@@ -195,8 +197,8 @@ public:
 
     RsAmf0Package *get(int index);
 
-protected:
-    std::string encode();
+public:
+    void encode(RsBufferLittleEndian &buf);
 
 public:
     int initialize(IRsReaderWriter *reader);
@@ -208,8 +210,8 @@ public:
 
     virtual ~RsAmf0Null();
 
-protected:
-    std::string encode();
+public:
+    void encode(RsBufferLittleEndian &buf);
 
 public:
     int initialize(IRsReaderWriter *reader);
@@ -221,8 +223,8 @@ public:
 
     virtual ~RsAmf0Undefined();
 
-protected:
-    std::string encode();
+public:
+    void encode(RsBufferLittleEndian &buf);
 
 public:
     int initialize(IRsReaderWriter *reader);
@@ -238,8 +240,8 @@ public:
 
     virtual ~RsAmf0Reference();
 
-protected:
-    std::string encode();
+public:
+    void encode(RsBufferLittleEndian &buf);
 
 public:
     int initialize(IRsReaderWriter *reader);
@@ -261,8 +263,8 @@ public:
 
     RsAmf0Package *get(int index);
 
-protected:
-    std::string encode();
+public:
+    void encode(RsBufferLittleEndian &buf);
 
 public:
     int initialize(IRsReaderWriter *reader);
@@ -282,8 +284,8 @@ public:
 
     RsAmf0Package *get(int index);
 
-protected:
-    std::string encode();
+public:
+    void encode(RsBufferLittleEndian &buf);
 
 public:
     int initialize(IRsReaderWriter *reader);
@@ -25,7 +25,7 @@ SOFTWARE.
 #ifndef RS_PROTOCOL_ASYNC_INTERFACE_H_
 #define RS_PROTOCOL_ASYNC_INTERFACE_H_
 
-#include <vector>
+#include <cstddef>
 #include <stdint.h>
 
 class IRsAsyncMsg {
@@ -35,7 +35,8 @@ public:
     virtual ~IRsAsyncMsg() = default;
 
 public:
-    virtual int on_msg(std::vector<uint8_t> &) = 0;
+    // feed the bytes as they arrive, the message may span any number of calls
+    virtual int on_msg(const char *buf, size_t size) = 0;
 };
 
 #endif
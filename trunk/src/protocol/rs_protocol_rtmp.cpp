@@ -25,99 +25,184 @@ SOFTWARE.
 #include "rs_kernel_buffer.h"
 #include "rs_protocol_rtmp.h"
 #include "rs_module_log.h"
+#include "rs_kernel_loop.h"
+#include "rs_kernel_sha256.h"
 
 #define CHUNK_MESSAGE_TIMESTAMP_MAX 16777215
 
-int RtmpHandshakeC0C1::initialize() {
-    int ret = ERROR_SUCCESS;
+// chunk messages are recycled by the pool of the loop which creates them
+static std::shared_ptr<RsRtmpChunkMessage> create_pooled_chunk_message() {
+    auto loop = RsLoop::get_instance();
+    return std::shared_ptr<RsRtmpChunkMessage>(
+            loop->get_pool<RsRtmpChunkMessage>().allocate(),
+            [loop](RsRtmpChunkMessage *p) {
+                loop->get_pool<RsRtmpChunkMessage>().release(p);
+            });
+}
 
-    version = 0x03;
-    timestamp = (uint32_t) rs_get_system_time_ms();
-    zero = 0;
-    random_data = rs_get_random(1528);
-    return ret;
+RtmpHandshakeAsync::RtmpHandshakeAsync() : _status(rs_rtmp_handshake_c0c1), _param(nullptr) {
 }
 
-int RtmpHandshakeC0C1::initialize(std::string &buf) {
-    int ret = ERROR_SUCCESS;
+void RtmpHandshakeAsync::set_callbacks(handshake_reply_cb reply_cb, handshake_done_cb done_cb,
+                                       void *param) {
+    _reply_cb = std::move(reply_cb);
+    _done_cb = std::move(done_cb);
+    _param = param;
+}
 
-    if (buf.size() < 1537) {
-        ret = ERROR_RTMP_PROTOCOL_C0C1_LENGTH_ERROR;
-        return ret;
+const char *RtmpHandshakeAsync::gather(const char *&buf, size_t &size, size_t n) {
+    if (_pending.empty() && size >= n) {
+        auto p = buf;
+        buf += n;
+        size -= n;
+        return p;
     }
 
-    RsBufferLittleEndian buffer;
-    buffer.write_bytes(buf.c_str(), (int) buf.size());
+    auto copy = std::min(n - _pending.size(), size);
+    _pending.append(buf, copy);
+    buf += copy;
+    size -= copy;
 
-    if (buffer.read_1_byte() != 0x03) {
-        ret = ERROR_RTMP_PROTOCOL_VERSION_ERROR;
-        return ret;
+    if (_pending.size() < n) {
+        return nullptr;
     }
 
-    timestamp = buffer.read_4_byte();
-    zero = buffer.read_4_byte();
-
-    random_data = buffer.read_bytes(1528);
-
-    return ret;
+    return _pending.data();
 }
 
-int RtmpHandshakeC0C1::initialize(RsBufferLittleEndian *buffer) {
-    int ret = ERROR_SUCCESS;
-
-    if (buffer->length() < 1537) {
-        ret = ERROR_RTMP_PROTOCOL_C0C1_LENGTH_ERROR;
-        return ret;
-    }
-
-    std::string c0c1_body;
-
-    buffer->read(c0c1_body, 1537);
+// the keys of the complex handshake, the first 30 and 36 bytes are the readable part
+static const uint8_t rtmp_genuine_fp_key[] = {
+        'G', 'e', 'n', 'u', 'i', 'n', 'e', ' ', 'A', 'd', 'o', 'b', 'e', ' ', 'F', 'l', 'a', 's', 'h', ' ',
+        'P', 'l', 'a', 'y', 'e', 'r', ' ', '0', '0', '1',
+        0xf0, 0xee, 0xc2, 0x4a, 0x80, 0x68, 0xbe, 0xe8, 0x2e, 0x00, 0xd0, 0xd1, 0x02, 0x9e, 0x7e, 0x57,
+        0x6e, 0xec, 0x5d, 0x2d, 0x29, 0x80, 0x6f, 0xab, 0x93, 0xb8, 0xe6, 0x36, 0xcf, 0xeb, 0x31, 0xae
+};
+
+static const uint8_t rtmp_genuine_fms_key[] = {
+        'G', 'e', 'n', 'u', 'i', 'n', 'e', ' ', 'A', 'd', 'o', 'b', 'e', ' ', 'F', 'l', 'a', 's', 'h', ' ',
+        'M', 'e', 'd', 'i', 'a', ' ', 'S', 'e', 'r', 'v', 'e', 'r', ' ', '0', '0', '1',
+        0xf0, 0xee, 0xc2, 0x4a, 0x80, 0x68, 0xbe, 0xe8, 0x2e, 0x00, 0xd0, 0xd1, 0x02, 0x9e, 0x7e, 0x57,
+        0x6e, 0xec, 0x5d, 0x2d, 0x29, 0x80, 0x6f, 0xab, 0x93, 0xb8, 0xe6, 0x36, 0xcf, 0xeb, 0x31, 0xae
+};
+
+// the pad states of the fixed keys are computed once at startup and shared by all loops
+static const RsHmacSha256 rtmp_player_hmac(rtmp_genuine_fp_key, 30);
+static const RsHmacSha256 rtmp_server_hmac(rtmp_genuine_fms_key, 36);
+static const RsHmacSha256 rtmp_server_full_hmac(rtmp_genuine_fms_key, sizeof(rtmp_genuine_fms_key));
+
+// the digest block is at 8 for schema 0 and at 772 for schema 1, led by 4 bytes of offset
+static size_t get_digest_offset(const char *c1, size_t base) {
+    auto b = (const uint8_t *) c1 + base;
+    return (b[0] + b[1] + b[2] + b[3]) % 728 + base + 4;
+}
 
-    return initialize(c0c1_body);
+// the digest of c1 or s1 covers all the bytes but itself
+static void sign_digest(const RsHmacSha256 &hmac, const char *p, size_t offset, uint8_t *digest) {
+    RsSlice parts[2] = {
+            RsSlice(p, offset),
+            RsSlice(p + offset + RS_SHA256_DIGEST_SIZE, RS_RTMP_C2_SIZE - offset - RS_SHA256_DIGEST_SIZE)
+    };
+    hmac.sign(parts, 2, digest);
 }
 
-std::string RtmpHandshakeC0C1::dump() {
-    RsBufferLittleEndian buf;
+// the offset of the digest when c1 is signed by a flash player, or 0
+static size_t find_c1_digest(const char *c1) {
+    // zero version is for the simple handshake
+    if (rs_read_be<uint32_t>(c1 + 4) == 0) {
+        return 0;
+    }
 
-    buf.write_1_byte(version);
-    buf.write_4_byte(timestamp);
-    buf.write_4_byte(zero);
-    buf.write_bytes(random_data);
+    uint8_t digest[RS_SHA256_DIGEST_SIZE];
+    for (size_t base : {772, 8}) {
+        auto offset = get_digest_offset(c1, base);
+        sign_digest(rtmp_player_hmac, c1, offset, digest);
+        if (memcmp(digest, c1 + offset, RS_SHA256_DIGEST_SIZE) == 0) {
+            return offset;
+        }
+    }
 
-    return std::string(buf.dump());
+    return 0;
 }
 
-int RtmpHandshakeC2::initialize() {
+int RtmpHandshakeAsync::on_c0c1(const char *p) {
     int ret = ERROR_SUCCESS;
-    timestamp = (uint32_t) rs_get_system_time_ms();
-    timestamp2 = 0;
-    random_data = rs_get_random(1528);
-    return ret;
-}
 
-int RtmpHandshakeC2::initialize(uint32_t ts, const std::string &rd) {
-    int ret = ERROR_SUCCESS;
+    if (p[0] != 0x03) {
+        ret = ERROR_RTMP_PROTOCOL_VERSION_ERROR;
+        rs_error(nullptr, "rtmp version %d of c0 not supported. ret=%d", (uint8_t) p[0], ret);
+        return ret;
+    }
 
-    timestamp = (uint32_t) rs_get_system_time_ms();
-    timestamp2 = ts;
-    random_data = rd;
+    auto block = RsLoop::get_instance()->get_buffer_pool()->allocate(RS_RTMP_S0S1S2_SIZE);
+    auto now = (uint32_t) rs_get_system_time_ms();
+    const char *c1 = p + 1;
+    char *s = block.get();
+    char *s1 = s + 1;
+    char *s2 = s + 1537;
+
+    // s0
+    s[0] = 0x03;
+
+    // s1, time, zero and random
+    rs_write_be<uint32_t>(s1, now);
+    rs_write_be<uint32_t>(s1 + 4, 0);
+    memcpy(s1 + 8, rs_get_random(1528).data(), 1528);
+
+    auto c1_digest_offset = find_c1_digest(c1);
+    if (c1_digest_offset == 0) {
+        // s2 echoes c1 with the time it is read
+        memcpy(s2, c1, RS_RTMP_C2_SIZE);
+        rs_write_be<uint32_t>(s2 + 4, now);
+    } else {
+        // s1 is signed in the schema of c1, with a nonzero version
+        auto base = c1_digest_offset < 772 ? 8 : 772;
+        rs_write_be<uint32_t>(s1 + 4, 0x0d0e0a0d);
+        auto offset = get_digest_offset(s1, base);
+        sign_digest(rtmp_server_hmac, s1, offset, (uint8_t *) s1 + offset);
+
+        // s2 is random, ends with the digest by a key from the digest of c1
+        uint8_t key[RS_SHA256_DIGEST_SIZE];
+        rtmp_server_full_hmac.sign(c1 + c1_digest_offset, RS_SHA256_DIGEST_SIZE, key);
+
+        auto s2_size = RS_RTMP_C2_SIZE - RS_SHA256_DIGEST_SIZE;
+        memcpy(s2, rs_get_random((int) s2_size).data(), s2_size);
+        RsHmacSha256(key, sizeof(key)).sign(s2, s2_size, (uint8_t *) s2 + s2_size);
+    }
+
+    if (_reply_cb) {
+        ret = _reply_cb(RsSharedSlice(block, RS_RTMP_S0S1S2_SIZE), _param);
+    }
 
     return ret;
 }
 
-std::string RtmpHandshakeC2::dump() {
-    RsBufferLittleEndian buf;
+int RtmpHandshakeAsync::on_msg(const char *buf, size_t size) {
+    auto ret = ERROR_SUCCESS;
 
-    buf.write_4_byte(timestamp);
-    buf.write_4_byte(timestamp2);
-    buf.write_bytes(random_data);
+    while (_status != rs_rtmp_handshake_done) {
+        auto n = _status == rs_rtmp_handshake_c0c1 ? RS_RTMP_C0C1_SIZE : RS_RTMP_C2_SIZE;
 
-    return std::string(buf.dump());
-}
+        const char *p = gather(buf, size, n);
+        if (p == nullptr) {
+            return ret;
+        }
 
-int RtmpHandshakeAsync::on_msg(std::vector<uint8_t> &buf) {
-    auto ret = ERROR_SUCCESS;
+        if (_status == rs_rtmp_handshake_c0c1) {
+            _status = rs_rtmp_handshake_c2;
+            ret = on_c0c1(p);
+        } else {
+            // c2 only echoes s1, it is not checked for either handshake
+            _status = rs_rtmp_handshake_done;
+            if (_done_cb) {
+                ret = _done_cb(buf, size, _param);
+            }
+        }
+
+        _pending.clear();
+        if (ret != ERROR_SUCCESS) {
+            return ret;
+        }
+    }
 
     return ret;
 }
@@ -125,48 +210,24 @@ int RtmpHandshakeAsync::on_msg(std::vector<uint8_t> &buf) {
 int RsRtmpChunkMessage::type_0_decode(IRsReaderWriter *reader) {
     int ret = ERROR_SUCCESS;
     bool has_extended_timestamp = false;
-    std::string buf;
+    RsSlice buf;
 
     assert(fmt == 0);
-    // read timestamp
-    if ((ret = reader->read(buf, 3)) != ERROR_SUCCESS) {
-        rs_error(reader, "read timestamp failed. ret=%d", ret);
+    // timestamp(3B), message length(3B), message type(1B), message stream id(4B)
+    if ((ret = reader->read(buf, 11)) != ERROR_SUCCESS) {
+        rs_error(reader, "read message header failed. ret=%d", ret);
         return ret;
     }
-    timestamp = RsBufferLittleEndian::convert_3bytes_into_uint32(buf);
-    buf.clear();
 
-    if (timestamp > CHUNK_MESSAGE_TIMESTAMP_MAX) {
-        has_extended_timestamp = true;
-    }
+    timestamp = rs_read_be24(buf.data);
+    message_length = rs_read_be24(buf.data + 3);
+    message_type_id = (uint8_t) buf.data[6];
+    message_stream_id = rs_read_le32(buf.data + 7);
 
-    // read message length
-    if ((ret = reader->read(buf, 3)) != ERROR_SUCCESS) {
-        rs_error(reader, "read message length failed. ret=%d", ret);
-        return ret;
-    }
-
-    message_length = RsBufferLittleEndian::convert_3bytes_into_uint32(buf);
-    buf.clear();
-
-    // read message type
-    if ((ret = reader->read(buf, 1)) != ERROR_SUCCESS) {
-        rs_error(reader, "read message type failed. ret=%d", ret);
-        return ret;
-    }
-
-    message_type_id = (uint8_t) buf.c_str()[0];
-    buf.clear();
-
-    // read message stream id
-    if ((ret = reader->read(buf, 4)) != ERROR_SUCCESS) {
-        rs_error(reader, "read message stream id failed. ret=%d", ret);
-        return ret;
+    if (timestamp >= CHUNK_MESSAGE_TIMESTAMP_MAX) {
+        has_extended_timestamp = true;
     }
 
-    message_stream_id = RsBufferLittleEndian::convert_4bytes_into_uint32(buf);
-    buf.clear();
-
     // read extend timestamp if there it is
     if (has_extended_timestamp) {
         if ((ret = reader->read(buf, 4)) != ERROR_SUCCESS) {
@@ -174,61 +235,47 @@ int RsRtmpChunkMessage::type_0_decode(IRsReaderWriter *reader) {
             return ret;
         }
 
-        extended_timestamp = RsBufferLittleEndian::convert_4bytes_into_uint32(buf);
-        buf.clear();
+        extended_timestamp = rs_read_be<uint32_t>(buf.data);
     }
 
     // read payload
     int length = message_length > chunk_size ? chunk_size : message_length;
-    if ((ret = reader->read(chunk_data, length)) != ERROR_SUCCESS) {
+    if ((ret = reader->read(buf, length)) != ERROR_SUCCESS) {
         rs_error(reader, "read message payload failed. ret=%d", ret);
         return ret;
     }
+    chunk_data.assign(buf.data, buf.size);
 
     return ERROR_SUCCESS;
 }
 
 int RsRtmpChunkMessage::type_1_decode(IRsReaderWriter *reader) {
     int ret = ERROR_SUCCESS;
-    std::string buf;
-
-    // timestamp delta
-    if ((ret = reader->read(buf, 3)) != ERROR_SUCCESS) {
-        rs_error(reader, "read timestamp delta failed. ret=%d", ret);
-        return ret;
-    }
-    timestamp_delta = RsBufferLittleEndian::convert_3bytes_into_uint32(buf);
-    buf.clear();
+    RsSlice buf;
 
-    // message length
-    if ((ret = reader->read(buf, 3)) != ERROR_SUCCESS) {
-        rs_error(reader, "read message length failed. ret=%d", ret);
+    // timestamp delta(3B), message length(3B), message type id(1B)
+    if ((ret = reader->read(buf, 7)) != ERROR_SUCCESS) {
+        rs_error(reader, "read message header failed. ret=%d", ret);
         return ret;
     }
-    message_length = RsBufferLittleEndian::convert_3bytes_into_uint32(buf);
-    buf.clear();
-
-    // message type id
-    if ((ret = reader->read(buf, 1)) != ERROR_SUCCESS) {
-        rs_error(reader, "read message type id failed. ret=%d", ret);
-        return ret;
-    }
-    message_type_id = (uint8_t) buf.c_str()[0];
-    buf.clear();
+    timestamp_delta = rs_read_be24(buf.data);
+    message_length = rs_read_be24(buf.data + 3);
+    message_type_id = (uint8_t) buf.data[6];
 
     // chunk data
     int length = message_length > chunk_size ? chunk_size : message_length;
-    if ((ret = reader->read(chunk_data, length)) != ERROR_SUCCESS) {
+    if ((ret = reader->read(buf, length)) != ERROR_SUCCESS) {
         rs_error(reader, "read chunk data failed. ret=%d", ret);
         return ret;
     }
+    chunk_data.assign(buf.data, buf.size);
 
     return ret;
 }
 
 int RsRtmpChunkMessage::type_2_decode(IRsReaderWriter *reader, uint32_t size) {
     int ret = ERROR_SUCCESS;
-    std::string buf;
+    RsSlice buf;
 
     // timestamp delta
     if ((ret = reader->read(buf, 3)) != ERROR_SUCCESS) {
@@ -236,57 +283,52 @@ int RsRtmpChunkMessage::type_2_decode(IRsReaderWriter *reader, uint32_t size) {
         return ret;
     }
 
-    timestamp_delta = RsBufferLittleEndian::convert_3bytes_into_uint32(buf);
-    buf.clear();
+    timestamp_delta = rs_read_be24(buf.data);
 
     // chunk data
-    if ((ret = reader->read(chunk_data, size)) != ERROR_SUCCESS) {
+    if ((ret = reader->read(buf, size)) != ERROR_SUCCESS) {
         rs_error(reader, "read chunk data failed. ret=%d", ret);
         return ret;
     }
+    chunk_data.assign(buf.data, buf.size);
 
     return ret;
 }
 
 int RsRtmpChunkMessage::type_3_decode(IRsReaderWriter *reader, uint32_t size) {
     int ret = ERROR_SUCCESS;
+    RsSlice buf;
 
-    if ((ret = reader->read(chunk_data, size)) != ERROR_SUCCESS) {
+    if ((ret = reader->read(buf, size)) != ERROR_SUCCESS) {
         rs_error(reader, "read chunk data from reader failed. ret=%d", ret);
+        return ret;
     }
+    chunk_data.assign(buf.data, buf.size);
 
     return ret;
 }
 
-std::string RsRtmpChunkMessage::basic_header_dump() {
-    RsBufferLittleEndian buf;
+void RsRtmpChunkMessage::basic_header_dump(RsBufferLittleEndian &buf) {
     if (cs_id < 64) {
         auto cid = static_cast<uint8_t>(cs_id);
         buf.write_1_byte((uint8_t) (((fmt << 6) & 0xc0) | (cid & 0x3f)));
-        return buf.dump();
     } else if (cs_id < 320) {
         auto cid = static_cast<uint8_t> (cs_id - 64);
         buf.write_1_byte((uint8_t) ((fmt << 6) & 0xc0));
         buf.write_1_byte(cid);
-        return buf.dump();
-    } else if (cs_id < 65599) {
-        buf.write_1_byte((uint8_t) ((fmt << 6) & 0xc0 + 1));
+    } else if (cs_id < 65600) {
+        buf.write_1_byte((uint8_t) (((fmt << 6) & 0xc0) | 1));
         auto cid = uint16_t(cs_id - 64);
         buf.write_1_byte((uint8_t) cid);
         buf.write_1_byte((uint8_t) (cid >> 8));
-        return buf.dump();
     }
-
-    return "";
 }
 
-int RsRtmpChunkMessage::type_0_dump(std::string &buf) {
+int RsRtmpChunkMessage::type_0_dump(RsBufferLittleEndian &rs_buf) {
     int ret = ERROR_SUCCESS;
 
-    RsBufferLittleEndian rs_buf;
-
     // basic header
-    rs_buf.write_bytes(basic_header_dump());
+    basic_header_dump(rs_buf);
     // timestamp
     rs_buf.write_3_byte(timestamp);
     // message_length
@@ -294,25 +336,24 @@ int RsRtmpChunkMessage::type_0_dump(std::string &buf) {
     // message type id
     rs_buf.write_1_byte(message_type_id);
     // message stream id
-    rs_buf.write_4_byte(message_stream_id);
+    char stream_id[4];
+    rs_write_le32(stream_id, message_stream_id);
+    rs_buf.write_bytes(stream_id, 4);
     // extended timestamp
     if (timestamp >= CHUNK_MESSAGE_TIMESTAMP_MAX && extended_timestamp != 0) {
         rs_buf.write_4_byte(extended_timestamp);
     }
     // chunk data
-    rs_buf.write_bytes(chunk_data);
+    rs_buf.write_bytes(chunk_data.data(), (int) chunk_data.size());
 
-    buf = rs_buf.dump();
     return ret;
 }
 
-int RsRtmpChunkMessage::type_1_dump(std::string &buf) {
+int RsRtmpChunkMessage::type_1_dump(RsBufferLittleEndian &rs_buf) {
     int ret = ERROR_SUCCESS;
 
-    RsBufferLittleEndian rs_buf;
-
     //basic header
-    rs_buf.write_bytes(basic_header_dump());
+    basic_header_dump(rs_buf);
     // timestamp delta
     rs_buf.write_3_byte(timestamp_delta);
     // message length
@@ -320,32 +361,30 @@ int RsRtmpChunkMessage::type_1_dump(std::string &buf) {
     // message type id
     rs_buf.write_1_byte(message_type_id);
     // chunk data
-    rs_buf.write_bytes(chunk_data);
+    rs_buf.write_bytes(chunk_data.data(), (int) chunk_data.size());
 
-    buf = rs_buf.dump();
     return ret;
 }
 
-int RsRtmpChunkMessage::type_2_dump(std::string &buf) {
+int RsRtmpChunkMessage::type_2_dump(RsBufferLittleEndian &rs_buf) {
     int ret = ERROR_SUCCESS;
 
-    RsBufferLittleEndian rs_buf;
-
     // basic header
-    rs_buf.write_bytes(basic_header_dump());
+    basic_header_dump(rs_buf);
     // timestamp delta
     rs_buf.write_3_byte(timestamp_delta);
     // chunk data
-    rs_buf.write_bytes(chunk_data);
+    rs_buf.write_bytes(chunk_data.data(), (int) chunk_data.size());
 
-    buf = rs_buf.dump();
     return ret;
 }
 
-int RsRtmpChunkMessage::type_3_dump(std::string &buf) {
+int RsRtmpChunkMessage::type_3_dump(RsBufferLittleEndian &rs_buf) {
     int ret = ERROR_SUCCESS;
-    buf.append(basic_header_dump());
-    buf.append(chunk_data);
+
+    basic_header_dump(rs_buf);
+    rs_buf.write_bytes(chunk_data.data(), (int) chunk_data.size());
+
     return ret;
 }
 
@@ -355,35 +394,33 @@ int RsRtmpChunkMessage::initialize(IRsReaderWriter *reader, uint32_t cs,
     chunk_size = cs;
 
     // read basic header
-    std::string buf;
-    if ((ret = reader->read(buf, 1) != ERROR_SUCCESS)) {
+    RsSlice buf;
+    if ((ret = reader->read(buf, 1)) != ERROR_SUCCESS) {
         rs_error(reader, "read fmt failed. ret=%d", ret);
         return ret;
     }
-    fmt = uint8_t((buf.c_str()[0] & 0xc0) >> 6);
+    fmt = uint8_t((buf.data[0] & 0xc0) >> 6);
 
-    int tmp = buf.c_str()[0] & 0x3f;
+    int tmp = buf.data[0] & 0x3f;
     if (tmp > 1) {
         cs_id = uint8_t(tmp);
     }
 
     if (tmp == 0) {
-        buf.clear();
         if ((ret = reader->read(buf, 1)) != ERROR_SUCCESS) {
             rs_error(reader, "read 1 byte failed. ret=%d", ret);
             return ret;
         }
-        cs_id = 64 + uint8_t(buf.c_str()[0]);
+        cs_id = 64 + uint8_t(buf.data[0]);
     }
 
     if (tmp == 1) {
-        buf.clear();
         if ((ret = reader->read(buf, 2)) != ERROR_SUCCESS) {
             rs_error(reader, "read 2 bytes failed. ret=%d", ret);
             return ret;
         }
 
-        cs_id = (uint32_t) (64 + uint8_t(buf.c_str()[0]) + 256 * uint8_t(buf.c_str()[1]));
+        cs_id = (uint32_t) (64 + uint8_t(buf.data[0]) + 256 * uint8_t(buf.data[1]));
     }
 
     // read message header and chunk data
@@ -407,31 +444,40 @@ int RsRtmpChunkMessage::dump(std::string &buf) {
     buf.clear();
 
     int ret = ERROR_SUCCESS;
+    RsBufferLittleEndian rs_buf;
 
     switch (fmt) {
         case 0:
-            return type_0_dump(buf);
+            ret = type_0_dump(rs_buf);
+            break;
         case 1:
-            return type_1_dump(buf);
+            ret = type_1_dump(rs_buf);
+            break;
         case 2:
-            return type_2_dump(buf);
+            ret = type_2_dump(rs_buf);
+            break;
         case 3:
-            return type_3_dump(buf);
+            ret = type_3_dump(rs_buf);
+            break;
         default:
             ret = ERROR_RTMP_PROTOCOL_FMT_BEYOND_LIMIT;
             break;
     }
 
+    if (ret == ERROR_SUCCESS) {
+        buf = rs_buf.dump();
+    }
+
     return ret;
 }
 
 RTMP_CHUNK_MESSAGES
-RsRtmpChunkMessage::create_chunk_messages(uint32_t ts, std::string msg, uint8_t msg_type,
+RsRtmpChunkMessage::create_chunk_messages(uint32_t ts, const std::string &msg, uint8_t msg_type,
                                           uint32_t msg_stream_id, uint32_t cs) {
     RTMP_CHUNK_MESSAGES msgs;
 
     // create type 0 message
-    auto *type0 = new RsRtmpChunkMessage();
+    auto type0 = create_pooled_chunk_message();
     type0->fmt = 0;
     type0->chunk_size = cs;
     type0->timestamp = ts;
@@ -444,56 +490,684 @@ RsRtmpChunkMessage::create_chunk_messages(uint32_t ts, std::string msg, uint8_t
     type0->message_type_id = msg_type;
     type0->message_stream_id = msg_stream_id;
 
-    auto data_length = msg.length() > cs ? cs : msg.length();
-    type0->chunk_data = msg.substr(0, data_length);
-    msg.erase(0, data_length);
+    size_t pos = std::min((size_t) cs, msg.length());
+    type0->chunk_data.assign(msg, 0, pos);
 
-    msgs.push_back(std::shared_ptr<RsRtmpChunkMessage>(type0));
+    msgs.push_back(type0);
 
     // create type 3 messages
-    while (!msg.empty()) {
-        auto *type3 = new RsRtmpChunkMessage();
+    while (pos < msg.length()) {
+        auto type3 = create_pooled_chunk_message();
         type3->fmt = 3;
-        auto length = msg.length() > cs ? cs : msg.length();
-        type3->chunk_data = msg.substr(0, length);
-        msg.erase(0, length);
+        auto length = std::min((size_t) cs, msg.length() - pos);
+        type3->chunk_data.assign(msg, pos, length);
+        pos += length;
 
-        msgs.push_back(std::shared_ptr<RsRtmpChunkMessage>(type3));
+        msgs.push_back(type3);
     }
 
     return msgs;
 }
 
-bool RsRtmpChunkHeaderAsync::is_completed() {
-    return _status == rs_rtmp_chunk_header_completed;
+bool rs_rtmp_is_video_keyframe(const RsRtmpMessage &msg) {
+    // frame type 1 in the high 4 bits
+    return msg.type_id == RS_RTMP_MSG_VIDEO && msg.payload.size() >= 1 &&
+           ((uint8_t) msg.payload.data()[0] >> 4) == 1;
+}
+
+bool rs_rtmp_is_video_sequence_header(const RsRtmpMessage &msg) {
+    if (!rs_rtmp_is_video_keyframe(msg) || msg.payload.size() < 2) {
+        return false;
+    }
+
+    // codec 7 for avc and 12 for hevc, then packet type 0
+    auto codec = (uint8_t) msg.payload.data()[0] & 0x0f;
+    return (codec == 7 || codec == 12) && msg.payload.data()[1] == 0;
+}
+
+bool rs_rtmp_is_audio_sequence_header(const RsRtmpMessage &msg) {
+    if (msg.type_id != RS_RTMP_MSG_AUDIO || msg.payload.size() < 2) {
+        return false;
+    }
+
+    // sound format 10 for aac, then packet type 0
+    return ((uint8_t) msg.payload.data()[0] >> 4) == 10 && msg.payload.data()[1] == 0;
+}
+
+void rs_rtmp_remove_set_data_frame(RsRtmpMessage &msg) {
+    // the amf0 string marker, 2 bytes length and the name
+    static const char name[] = "\x02\x00\x0d@setDataFrame";
+    static const size_t size = sizeof(name) - 1;
+
+    if (msg.type_id == RS_RTMP_MSG_AMF0_DATA && msg.payload.size() > size &&
+        memcmp(msg.payload.data(), name, size) == 0) {
+        msg.payload = msg.payload.sub(size, msg.payload.size() - size);
+    }
+}
+
+std::string rs_rtmp_get_data_name(const RsRtmpMessage &msg) {
+    auto p = msg.payload.data();
+    size_t size = msg.payload.size();
+
+    // amf3 data starts with a byte of 0, then the values in amf0
+    if (msg.type_id == RS_RTMP_MSG_AMF3_DATA && size > 0 && p[0] == 0) {
+        p++;
+        size--;
+    } else if (msg.type_id != RS_RTMP_MSG_AMF0_DATA) {
+        return "";
+    }
+
+    // the amf0 string marker, 2 bytes length and the name
+    if (size < 3 || (uint8_t) p[0] != AMF0_MARKER::AMF0_STRING) {
+        return "";
+    }
+
+    auto length = rs_read_be<uint16_t>(p + 1);
+    if (size < 3 + (size_t) length) {
+        return "";
+    }
+
+    return std::string(p + 3, length);
+}
+
+RsRtmpMessage rs_rtmp_create_control_message(uint8_t type_id, uint32_t value) {
+    char buf[4];
+    rs_write_be<uint32_t>(buf, value);
+
+    RsRtmpMessage msg;
+    msg.cs_id = RS_RTMP_CSID_PROTOCOL_CONTROL;
+    msg.timestamp = 0;
+    msg.type_id = type_id;
+    msg.stream_id = 0;
+    msg.payload = RsSharedSlice::copy_from(buf, sizeof(buf));
+
+    return msg;
+}
+
+RsRtmpMessage rs_rtmp_create_set_peer_bandwidth(uint32_t window, uint8_t limit_type) {
+    char buf[5];
+    rs_write_be<uint32_t>(buf, window);
+    buf[4] = char(limit_type);
+
+    auto msg = rs_rtmp_create_control_message(RS_RTMP_MSG_SET_PEER_BANDWIDTH, 0);
+    msg.payload = RsSharedSlice::copy_from(buf, sizeof(buf));
+
+    return msg;
+}
+
+RsRtmpMessage rs_rtmp_create_user_control(uint16_t event, uint32_t value) {
+    char buf[6];
+    rs_write_be<uint16_t>(buf, event);
+    rs_write_be<uint32_t>(buf + 2, value);
+
+    auto msg = rs_rtmp_create_control_message(RS_RTMP_MSG_USER_CONTROL, 0);
+    msg.payload = RsSharedSlice::copy_from(buf, sizeof(buf));
+
+    return msg;
+}
+
+int rs_rtmp_decode_control_message(const RsRtmpMessage &msg, uint32_t &value) {
+    int ret = ERROR_SUCCESS;
+
+    if (msg.payload.size() < 4) {
+        ret = ERROR_RTMP_PROTOCOL_CONTROL_MESSAGE_ERROR;
+        rs_error(nullptr, "control message type=%d of %u bytes. ret=%d", msg.type_id,
+                 (uint32_t) msg.payload.size(), ret);
+        return ret;
+    }
+
+    value = rs_read_be<uint32_t>(msg.payload.data());
+    return ret;
+}
+
+int RsRtmpCommand::initialize(const RsRtmpMessage &msg) {
+    int ret = ERROR_SUCCESS;
+
+    RsBufferLittleEndian buf;
+    buf.write_bytes(msg.payload.data(), (int) msg.payload.size());
+
+    std::unique_ptr<RsAmf0Package> pkg(RsAmf0Package::create_package(&buf));
+    if (pkg == nullptr || !pkg->is_string()) {
+        ret = ERROR_RTMP_PROTOCOL_COMMAND_ERROR;
+        rs_error(nullptr, "the command name should be amf0 string. ret=%d", ret);
+        return ret;
+    }
+    name = dynamic_cast<RsAmf0String *>(pkg.get())->value;
+
+    pkg.reset(RsAmf0Package::create_package(&buf));
+    if (pkg == nullptr || !pkg->is_number()) {
+        ret = ERROR_RTMP_PROTOCOL_COMMAND_ERROR;
+        rs_error(nullptr, "the transaction id of %s should be amf0 number. ret=%d", name.c_str(), ret);
+        return ret;
+    }
+    transaction_id = dynamic_cast<RsAmf0Number *>(pkg.get())->value;
+
+    values.clear();
+    while (buf.length() > 0) {
+        auto value = RsAmf0Package::create_package(&buf);
+        if (value == nullptr) {
+            ret = ERROR_RTMP_PROTOCOL_COMMAND_ERROR;
+            rs_error(nullptr, "decode the value %u of %s failed. ret=%d", (uint32_t) values.size(),
+                     name.c_str(), ret);
+            return ret;
+        }
+        add(value);
+    }
+
+    return ret;
+}
+
+void RsRtmpCommand::add(RsAmf0Package *value) {
+    values.push_back(std::shared_ptr<RsAmf0Package>(value));
+}
+
+RsAmf0Package *RsRtmpCommand::get(size_t index) {
+    return index < values.size() ? values[index].get() : nullptr;
+}
+
+RsRtmpMessage RsRtmpCommand::dump(uint32_t stream_id) {
+    RsBufferLittleEndian buf;
+    RsAmf0String(name).encode(buf);
+    RsAmf0Number(transaction_id).encode(buf);
+    for (auto &value : values) {
+        value->encode(buf);
+    }
+
+    RsRtmpMessage msg;
+    msg.cs_id = RS_RTMP_CSID_COMMAND;
+    msg.timestamp = 0;
+    msg.type_id = RS_RTMP_MSG_AMF0_COMMAND;
+    msg.stream_id = stream_id;
+
+    RsSlice slice;
+    buf.peek(slice, (int) buf.length());
+    msg.payload = RsSharedSlice::copy_from(slice.data, slice.size);
+
+    return msg;
+}
+
+RsRtmpChunkMsgAsync::RsRtmpChunkMsgAsync() : _status(rs_rtmp_chunk_basic_header),
+                                             _chunk_size(RS_RTMP_DEFAULT_CHUNK_SIZE),
+                                             _max_message_size(RS_RTMP_DEFAULT_MAX_MESSAGE_SIZE),
+                                             _scratch_size(0), _fmt(0), _cs_id(0),
+                                             _timestamp_field(0), _stream(nullptr),
+                                             _chunk_left(0), _message_param(nullptr) {
+    _buffer_pool = RsLoop::get_instance()->get_buffer_pool();
 }
 
-int RsRtmpChunkHeaderAsync::on_msg(std::vector<uint8_t> &buf) {
+void RsRtmpChunkMsgAsync::set_message_cb(rtmp_message_cb cb, void *param) {
+    _message_cb = std::move(cb);
+    _message_param = param;
+}
+
+void RsRtmpChunkMsgAsync::set_chunk_size(uint32_t chunk_size) {
+    _chunk_size = chunk_size;
+}
+
+void RsRtmpChunkMsgAsync::set_max_message_size(uint32_t max_message_size) {
+    _max_message_size = max_message_size;
+}
+
+const char *RsRtmpChunkMsgAsync::gather(const char *&buf, size_t &size, size_t n) {
+    // the usual case, the whole part is in this read
+    if (_scratch_size == 0 && size >= n) {
+        auto p = buf;
+        buf += n;
+        size -= n;
+        return p;
+    }
+
+    auto copy = std::min(n - _scratch_size, size);
+    memcpy(_scratch + _scratch_size, buf, copy);
+    _scratch_size += copy;
+    buf += copy;
+    size -= copy;
+
+    if (_scratch_size < n) {
+        return nullptr;
+    }
+
+    _scratch_size = 0;
+    return _scratch;
+}
+
+int RsRtmpChunkMsgAsync::on_basic_header() {
     int ret = ERROR_SUCCESS;
 
+    _stream = &_streams.get(_cs_id);
+
+    if (_fmt != 0 && !_stream->has_header) {
+        ret = ERROR_RTMP_PROTOCOL_CHUNK_STREAM_NO_HEADER;
+        rs_error(nullptr, "chunk of fmt=%d on cs_id=%u without any previous header. ret=%d",
+                 _fmt, _cs_id, ret);
+        return ret;
+    }
+
+    // only type 3 chunks may continue a message
+    if (_fmt != 3 && _stream->received > 0) {
+        ret = ERROR_RTMP_PROTOCOL_CHUNK_INTERRUPTED;
+        rs_error(nullptr, "chunk of fmt=%d interrupts the message on cs_id=%u. ret=%d",
+                 _fmt, _cs_id, ret);
+        return ret;
+    }
+
+    if (_fmt == 3) {
+        if (_stream->extended) {
+            _status = rs_rtmp_chunk_extended_timestamp;
+            return ret;
+        }
+
+        return on_header_completed();
+    }
+
+    _status = rs_rtmp_chunk_message_header;
     return ret;
 }
 
-bool RsRtmpChunkMsgAsync::is_completed() {
-    return _status == rs_rtmp_chunk_message_completed;
+int RsRtmpChunkMsgAsync::on_message_header(const char *p) {
+    // timestamp or delta(3B), message length(3B), message type(1B), message stream id(4B)
+    _timestamp_field = rs_read_be24(p);
+
+    if (_fmt <= 1) {
+        _stream->message_length = rs_read_be24(p + 3);
+        _stream->type_id = (uint8_t) p[6];
+    }
+
+    if (_fmt == 0) {
+        _stream->stream_id = rs_read_le32(p + 7);
+    }
+
+    _stream->extended = _timestamp_field >= CHUNK_MESSAGE_TIMESTAMP_MAX;
+    if (_stream->extended) {
+        _status = rs_rtmp_chunk_extended_timestamp;
+        return ERROR_SUCCESS;
+    }
+
+    return on_header_completed();
 }
 
-void RsRtmpChunkMsgAsync::clear() {
-    _cache_buffer.clear();
-    _status = rs_rtmp_chunk_message_uninitialized;
+int RsRtmpChunkMsgAsync::on_header_completed() {
+    int ret = ERROR_SUCCESS;
+
+    auto stream = _stream;
+
+    if (_fmt == 0) {
+        stream->timestamp = _timestamp_field;
+        stream->timestamp_delta = _timestamp_field;
+    } else if (_fmt <= 2) {
+        stream->timestamp_delta = _timestamp_field;
+        stream->timestamp += _timestamp_field;
+    } else if (stream->received == 0) {
+        // type 3 starting a new message repeats the last delta
+        stream->timestamp += stream->timestamp_delta;
+    }
+
+    stream->has_header = true;
+
+    if (stream->message_length == 0) {
+        return on_message_completed();
+    }
+
+    // the whole message is allocated once by its first chunk
+    if (stream->received == 0) {
+        if (stream->message_length > _max_message_size) {
+            ret = ERROR_RTMP_PROTOCOL_MESSAGE_TOO_LARGE;
+            rs_error(nullptr, "message of %u bytes on cs_id=%u beyond the limit %u. ret=%d",
+                     stream->message_length, _cs_id, _max_message_size, ret);
+            return ret;
+        }
+
+        stream->block = _buffer_pool->allocate(stream->message_length);
+    }
+
+    auto left = stream->message_length - stream->received;
+    _chunk_left = std::min(left, _chunk_size);
+    _status = rs_rtmp_chunk_payload;
+
+    return ret;
+}
+
+int RsRtmpChunkMsgAsync::on_message_completed() {
+    int ret = ERROR_SUCCESS;
+
+    _status = rs_rtmp_chunk_basic_header;
+
+    RsRtmpMessage msg;
+    msg.cs_id = _cs_id;
+    msg.timestamp = _stream->timestamp;
+    msg.type_id = _stream->type_id;
+    msg.stream_id = _stream->stream_id;
+    msg.payload = RsSharedSlice(std::move(_stream->block), _stream->received);
+    _stream->block.reset();
+    _stream->received = 0;
+
+    if (_message_cb && (ret = _message_cb(msg, _message_param)) != ERROR_SUCCESS) {
+        return ret;
+    }
+
+    return ret;
 }
 
-int RsRtmpChunkMsgAsync::on_msg(std::vector<uint8_t> &buf) {
+int RsRtmpChunkMsgAsync::on_msg(const char *buf, size_t size) {
     int ret = ERROR_SUCCESS;
 
-    do {
-        if (!_header.is_completed()) {
-            ret = _header.on_msg(buf);
-            continue;
+    while (size > 0) {
+        const char *p = nullptr;
+
+        switch (_status) {
+            case rs_rtmp_chunk_basic_header: {
+                if ((p = gather(buf, size, 1)) == nullptr) {
+                    return ret;
+                }
+
+                _fmt = uint8_t(((uint8_t) p[0] & 0xc0) >> 6);
+                _cs_id = (uint8_t) p[0] & 0x3f;
+
+                // 0 for 2 bytes basic header, 1 for 3 bytes
+                if (_cs_id <= 1) {
+                    _status = rs_rtmp_chunk_basic_header_ext;
+                    break;
+                }
+
+                ret = on_basic_header();
+                break;
+            }
+            case rs_rtmp_chunk_basic_header_ext: {
+                if ((p = gather(buf, size, _cs_id + 1)) == nullptr) {
+                    return ret;
+                }
+
+                if (_cs_id == 0) {
+                    _cs_id = 64 + (uint8_t) p[0];
+                } else {
+                    _cs_id = 64 + (uint8_t) p[0] + 256 * (uint8_t) p[1];
+                }
+
+                ret = on_basic_header();
+                break;
+            }
+            case rs_rtmp_chunk_message_header: {
+                static const size_t sizes[] = {11, 7, 3};
+                if ((p = gather(buf, size, sizes[_fmt])) == nullptr) {
+                    return ret;
+                }
+
+                ret = on_message_header(p);
+                break;
+            }
+            case rs_rtmp_chunk_extended_timestamp: {
+                if ((p = gather(buf, size, 4)) == nullptr) {
+                    return ret;
+                }
+
+                // a type 3 chunk repeats the extended timestamp of its message
+                if (_fmt != 3) {
+                    _timestamp_field = rs_read_be<uint32_t>(p);
+                }
+
+                ret = on_header_completed();
+                break;
+            }
+            case rs_rtmp_chunk_payload: {
+                auto n = std::min((size_t) _chunk_left, size);
+                memcpy(_stream->block.get() + _stream->received, buf, n);
+                _stream->received += n;
+                buf += n;
+                size -= n;
+                _chunk_left -= n;
+
+                if (_chunk_left > 0) {
+                    return ret;
+                }
+
+                if (_stream->received == _stream->message_length) {
+                    ret = on_message_completed();
+                } else {
+                    _status = rs_rtmp_chunk_basic_header;
+                }
+                break;
+            }
         }
 
-        // TODO:FIXME: implement this functions
-    } while (!buf.empty());
+        if (ret != ERROR_SUCCESS) {
+            return ret;
+        }
+    }
 
     return ret;
-}
\ No newline at end of file
+}
+
+// 1 to 3 bytes, returns the size written
+static size_t write_basic_header(char *p, uint8_t fmt, uint32_t cs_id) {
+    if (cs_id < 64) {
+        p[0] = char((fmt << 6) | cs_id);
+        return 1;
+    }
+
+    if (cs_id < 320) {
+        p[0] = char(fmt << 6);
+        p[1] = char(cs_id - 64);
+        return 2;
+    }
+
+    p[0] = char((fmt << 6) | 1);
+    p[1] = char((cs_id - 64) & 0xff);
+    p[2] = char((cs_id - 64) >> 8);
+    return 3;
+}
+
+static size_t get_chunk_count(uint32_t length, uint32_t chunk_size) {
+    return length == 0 ? 1 : (length + chunk_size - 1) / chunk_size;
+}
+
+/**
+ * the chunks after the first header into slices, the type 3 headers are written at p,
+ * which is in block and has room for them. returns the bytes appended.
+ * @remark extended only follows a type 0 header, so the repeated value is the timestamp.
+ */
+static size_t encode_chunk_body(const RsRtmpMessage &msg, uint32_t chunk_size, bool extended,
+                                const std::shared_ptr<char> &block, char *p,
+                                std::vector<RsSharedSlice> &slices) {
+    auto length = (uint32_t) msg.payload.size();
+    size_t bytes = 0;
+
+    auto n = std::min(chunk_size, length);
+    if (n > 0) {
+        slices.push_back(msg.payload.sub(0, n));
+    }
+    bytes += n;
+
+    for (uint32_t pos = n; pos < length; pos += n) {
+        char *start = p;
+
+        // type 3 chunks repeat the extended timestamp of their message
+        p += write_basic_header(p, 3, msg.cs_id);
+        if (extended) {
+            rs_write_be<uint32_t>(p, msg.timestamp);
+            p += 4;
+        }
+        slices.push_back(RsSharedSlice(block, start, p - start));
+
+        n = std::min(chunk_size, length - pos);
+        slices.push_back(msg.payload.sub(pos, n));
+        bytes += (p - start) + n;
+    }
+
+    return bytes;
+}
+
+// the size of the type 3 headers of a message
+static size_t get_chunk_body_headers_size(const RsRtmpMessage &msg, uint32_t chunk_size,
+                                          bool extended) {
+    return (get_chunk_count((uint32_t) msg.payload.size(), chunk_size) - 1) * (3 + (extended ? 4 : 0));
+}
+
+static std::shared_ptr<RsRtmpChunkBody> create_chunk_body(const RsRtmpMessage &msg, uint32_t chunk_size,
+                                                          bool extended, RsBufferPool *pool) {
+    auto body = std::make_shared<RsRtmpChunkBody>();
+    body->chunk_size = chunk_size;
+    body->cs_id = msg.cs_id;
+    body->extended = extended;
+
+    std::shared_ptr<char> block;
+    auto headers_size = get_chunk_body_headers_size(msg, chunk_size, extended);
+    if (headers_size > 0) {
+        block = pool->allocate(headers_size);
+    }
+    body->slices.reserve(2 * get_chunk_count((uint32_t) msg.payload.size(), chunk_size));
+    body->bytes = encode_chunk_body(msg, chunk_size, extended, block, block.get(), body->slices);
+
+    return body;
+}
+
+static bool is_chunk_body_of(const RsRtmpChunkBody &body, const RsRtmpMessage &msg,
+                             uint32_t chunk_size, bool extended) {
+    return body.chunk_size == chunk_size && body.cs_id == msg.cs_id && body.extended == extended;
+}
+
+RsRtmpSharedMessage::RsRtmpSharedMessage(RsRtmpMessage msg) : _msg(std::move(msg)) {
+}
+
+void RsRtmpSharedMessage::frame(uint32_t chunk_size, RsBufferPool *pool) {
+    // the type 3 headers only repeat the timestamp after a type 0 header of a large one
+    _framed = create_chunk_body(_msg, chunk_size, _msg.timestamp >= CHUNK_MESSAGE_TIMESTAMP_MAX, pool);
+}
+
+std::shared_ptr<RsRtmpChunkBody> RsRtmpSharedMessage::get_body(uint32_t chunk_size, bool extended,
+                                                               RsBufferPool *pool) {
+    if (_framed != nullptr && is_chunk_body_of(*_framed, _msg, chunk_size, extended)) {
+        return _framed;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    for (auto &body : _bodies) {
+        if (is_chunk_body_of(*body, _msg, chunk_size, extended)) {
+            return body;
+        }
+    }
+
+    auto body = create_chunk_body(_msg, chunk_size, extended, pool);
+    _bodies.push_back(body);
+    return body;
+}
+
+RsRtmpChunkEncoder::RsRtmpChunkEncoder() : _chunk_size(RS_RTMP_DEFAULT_CHUNK_SIZE), _arena_used(0) {
+    _buffer_pool = RsLoop::get_instance()->get_buffer_pool();
+}
+
+void RsRtmpChunkEncoder::set_chunk_size(uint32_t chunk_size) {
+    _chunk_size = chunk_size;
+}
+
+char *RsRtmpChunkEncoder::alloc_headers(size_t n) {
+    if (_arena == nullptr || _arena_used + n > RS_RTMP_HEADER_ARENA_SIZE) {
+        // a message of many chunks gets a block of its own
+        if (n > RS_RTMP_HEADER_ARENA_SIZE) {
+            _arena = _buffer_pool->allocate(n);
+            _arena_used = RS_RTMP_HEADER_ARENA_SIZE;
+            return _arena.get();
+        }
+
+        _arena = _buffer_pool->allocate(RS_RTMP_HEADER_ARENA_SIZE);
+        _arena_used = 0;
+    }
+
+    auto p = _arena.get() + _arena_used;
+    _arena_used += n;
+    return p;
+}
+
+size_t RsRtmpChunkEncoder::encode_first_header(const RsRtmpMessage &msg,
+                                               std::vector<RsSharedSlice> &slices,
+                                               bool &extended) {
+    auto &stream = _streams.get(msg.cs_id);
+    auto length = (uint32_t) msg.payload.size();
+    auto delta = msg.timestamp - stream.timestamp;
+
+    // type 0 when nothing to inherit, for the timestamp going back, or a delta that needs
+    // extended timestamp, so that the type 3 chunks always repeat an absolute timestamp
+    uint8_t fmt = 0;
+    if (stream.has_header && msg.stream_id == stream.stream_id &&
+        msg.timestamp >= stream.timestamp && delta < CHUNK_MESSAGE_TIMESTAMP_MAX) {
+        if (length != stream.message_length || msg.type_id != stream.type_id) {
+            fmt = 1;
+        } else if (stream.has_delta && !stream.extended && delta == stream.timestamp_delta) {
+            fmt = 3;
+        } else {
+            fmt = 2;
+        }
+    }
+
+    uint32_t field = fmt == 0 ? msg.timestamp : delta;
+    extended = field >= CHUNK_MESSAGE_TIMESTAMP_MAX;
+
+    char *start = alloc_headers(3 + 11 + 4);
+    char *p = start;
+
+    p += write_basic_header(p, fmt, msg.cs_id);
+    if (fmt <= 2) {
+        rs_write_be24(p, extended ? CHUNK_MESSAGE_TIMESTAMP_MAX : field);
+        p += 3;
+    }
+    if (fmt <= 1) {
+        rs_write_be24(p, length);
+        p[3] = char(msg.type_id);
+        p += 4;
+    }
+    if (fmt == 0) {
+        rs_write_le32(p, msg.stream_id);
+        p += 4;
+    }
+    if (extended) {
+        rs_write_be<uint32_t>(p, field);
+        p += 4;
+    }
+
+    stream.has_header = true;
+    stream.has_delta = fmt != 0;
+    stream.extended = extended;
+    stream.timestamp = msg.timestamp;
+    stream.timestamp_delta = field;
+    stream.message_length = length;
+    stream.type_id = msg.type_id;
+    stream.stream_id = msg.stream_id;
+
+    slices.push_back(RsSharedSlice(_arena, start, p - start));
+    return p - start;
+}
+
+size_t RsRtmpChunkEncoder::encode(const RsRtmpMessage &msg, std::vector<RsSharedSlice> &slices) {
+    bool extended = false;
+    auto bytes = encode_first_header(msg, slices, extended);
+
+    auto headers_size = get_chunk_body_headers_size(msg, _chunk_size, extended);
+    char *p = headers_size > 0 ? alloc_headers(headers_size) : nullptr;
+    bytes += encode_chunk_body(msg, _chunk_size, extended, _arena, p, slices);
+
+    return bytes;
+}
+
+size_t RsRtmpChunkEncoder::encode(RsRtmpSharedMessage &msg, std::vector<RsSharedSlice> &slices) {
+    bool extended = false;
+    auto bytes = encode_first_header(msg.get_message(), slices, extended);
+
+    auto body = msg.get_body(_chunk_size, extended, _buffer_pool.get());
+    slices.insert(slices.end(), body->slices.begin(), body->slices.end());
+    bytes += body->bytes;
+
+    return bytes;
+}
+
+void RsRtmpChunkEncoder::on_framed(const RsRtmpMessage &msg) {
+    auto &stream = _streams.get(msg.cs_id);
+
+    stream.has_header = true;
+    stream.has_delta = false;
+    stream.extended = msg.timestamp >= CHUNK_MESSAGE_TIMESTAMP_MAX;
+    stream.timestamp = msg.timestamp;
+    stream.timestamp_delta = msg.timestamp;
+    stream.message_length = (uint32_t) msg.payload.size();
+    stream.type_id = msg.type_id;
+    stream.stream_id = msg.stream_id;
+}
@@ -25,74 +25,62 @@ SOFTWARE.
 #ifndef RS_PROTOCOL_RTMP_H_
 #define RS_PROTOCOL_RTMP_H_
 
+#include <mutex>
+#include <unordered_map>
 #include "rs_common.h"
 #include "rs_kernel_io.h"
 #include "rs_kernel_buffer.h"
 #include "rs_protocol_async_interface.h"
+#include "rs_protocol_amf0.h"
 #include "uv.h"
 
-class RtmpHandshakeC0C1 {
-public:
-    uint8_t version;
-    uint32_t timestamp;
-    uint32_t zero;
-    std::string random_data;
-public:
-    RtmpHandshakeC0C1() = default;
-
-    virtual ~RtmpHandshakeC0C1() = default;
-
-public:
-    int initialize();
-
-    int initialize(std::string &buf);
-
-    int initialize(RsBufferLittleEndian *buffer);
-
-    std::string dump();
-};
-
-class RtmpHandshakeC2 {
-public:
-    uint32_t timestamp;
-    uint32_t timestamp2;
-    std::string random_data;
-public:
-    RtmpHandshakeC2() = default;
-
-    virtual ~RtmpHandshakeC2() = default;
-
-public:
-    int initialize();
-
-    int initialize(uint32_t ts, const std::string &rd);
+#define RS_RTMP_C0C1_SIZE 1537
+#define RS_RTMP_C2_SIZE 1536
+#define RS_RTMP_S0S1S2_SIZE 3073
+
+// s0s1s2 to send once c0c1 is received
+using handshake_reply_cb = std::function<int(const RsSharedSlice &s0s1s2, void *param)>;
+// c2 received, the bytes after it are the first chunks
+using handshake_done_cb = std::function<int(const char *buf, size_t size, void *param)>;
+
+/**
+ * the handshake of server, resumable over any split of the input. a c1 signed
+ * by a flash player gets the complex handshake, any other the simple one.
+ * c0c1 and c2 are parsed in place when they come in one read, and only copied
+ * when split; s0s1s2 is formatted into one block and written as is.
+ */
+class RtmpHandshakeAsync : public IRsAsyncMsg {
+private:
+    enum {
+        rs_rtmp_handshake_c0c1 = 0,
+        rs_rtmp_handshake_c2,
+        rs_rtmp_handshake_done
+    } _status;
 
-    std::string dump();
+    // a c0c1 or c2 split over reads
+    std::string _pending;
 
-};
-
-class RtmpHandshakeS0S1 : public RtmpHandshakeC0C1 {
+    handshake_reply_cb _reply_cb;
+    handshake_done_cb _done_cb;
+    void *_param;
 public:
-    RtmpHandshakeS0S1() = default;
+    RtmpHandshakeAsync();
 
-    virtual ~RtmpHandshakeS0S1() override = default;
-};
+    virtual ~RtmpHandshakeAsync() override = default;
 
-class RtmpHandshakeS2 : public RtmpHandshakeC2 {
-public:
-    RtmpHandshakeS2() = default;
+private:
+    // n contiguous bytes, or null to wait for more
+    const char *gather(const char *&buf, size_t &size, size_t n);
 
-    virtual ~RtmpHandshakeS2() override = default;
-};
+    int on_c0c1(const char *p);
 
-class RtmpHandshakeAsync : public IRsAsyncMsg {
 public:
-    RtmpHandshakeAsync() = default;
+    void set_callbacks(handshake_reply_cb reply_cb, handshake_done_cb done_cb, void *param);
 
-    virtual ~RtmpHandshakeAsync() override = default;
+    bool is_completed() { return _status == rs_rtmp_handshake_done; }
 
-public:
-    int on_msg(std::vector<uint8_t> &buf) override;
+    // must not be fed after completed, the rest of the read goes to done callback
+    int on_msg(const char *buf, size_t size) override;
 };
 
 class RsRtmpChunkMessage;
@@ -131,15 +119,15 @@ private:
 
     int type_3_decode(IRsReaderWriter *reader, uint32_t size);
 
-    std::string basic_header_dump();
+    void basic_header_dump(RsBufferLittleEndian &buf);
 
-    int type_0_dump(std::string &buf);
+    int type_0_dump(RsBufferLittleEndian &buf);
 
-    int type_1_dump(std::string &buf);
+    int type_1_dump(RsBufferLittleEndian &buf);
 
-    int type_2_dump(std::string &buf);
+    int type_2_dump(RsBufferLittleEndian &buf);
 
-    int type_3_dump(std::string &buf);
+    int type_3_dump(RsBufferLittleEndian &buf);
 
 public:
     int initialize(IRsReaderWriter *reader, uint32_t cs, uint32_t payload_length = 0);
@@ -148,70 +136,337 @@ public:
 
 public:
     static RTMP_CHUNK_MESSAGES
-    create_chunk_messages(uint32_t ts, std::string msg, uint8_t msg_type,
+    create_chunk_messages(uint32_t ts, const std::string &msg, uint8_t msg_type,
                           uint32_t msg_stream_id, uint32_t cs);
 };
 
-class RsRtmpChunkHeaderAsync : public IRsAsyncMsg {
+// the type id of rtmp messages
+#define RS_RTMP_MSG_SET_CHUNK_SIZE 1
+#define RS_RTMP_MSG_ABORT 2
+#define RS_RTMP_MSG_ACKNOWLEDGEMENT 3
+#define RS_RTMP_MSG_USER_CONTROL 4
+#define RS_RTMP_MSG_WINDOW_ACK_SIZE 5
+#define RS_RTMP_MSG_SET_PEER_BANDWIDTH 6
+#define RS_RTMP_MSG_AUDIO 8
+#define RS_RTMP_MSG_VIDEO 9
+#define RS_RTMP_MSG_AMF3_DATA 15
+#define RS_RTMP_MSG_AMF3_COMMAND 17
+#define RS_RTMP_MSG_AMF0_DATA 18
+#define RS_RTMP_MSG_AMF0_COMMAND 20
+
+// the cs_id of the messages sent by server
+#define RS_RTMP_CSID_PROTOCOL_CONTROL 2
+#define RS_RTMP_CSID_COMMAND 3
+#define RS_RTMP_CSID_DATA 5
+#define RS_RTMP_CSID_VIDEO 6
+#define RS_RTMP_CSID_AUDIO 7
+
+// the one message stream of a connection, answered to createStream
+#define RS_RTMP_STREAM_ID 1
+
+// the events of user control message
+#define RS_RTMP_USER_STREAM_BEGIN 0
+#define RS_RTMP_USER_STREAM_EOF 1
+
+// the default chunk size before any set chunk size
+#define RS_RTMP_DEFAULT_CHUNK_SIZE 128
+// the chunk sizes accepted from the peer
+#define RS_RTMP_MIN_CHUNK_SIZE 128
+#define RS_RTMP_MAX_CHUNK_SIZE 0xffffff
+// the largest message accepted by default, the length field allows 16MB
+#define RS_RTMP_DEFAULT_MAX_MESSAGE_SIZE (8 * 1024 * 1024)
+
+/**
+ * one complete rtmp message reassembled from its chunks
+ */
+struct RsRtmpMessage {
+    uint32_t cs_id;
+    uint32_t timestamp;
+    uint8_t type_id;
+    uint32_t stream_id;
+    // shared with no copy by whoever keeps the message
+    RsSharedSlice payload;
+};
+
+using rtmp_message_cb = std::function<int(RsRtmpMessage &msg, void *param)>;
+
+// the first bytes of audio and video payload are the flv tag header
+bool rs_rtmp_is_video_keyframe(const RsRtmpMessage &msg);
+
+// avc or hevc decoder configuration
+bool rs_rtmp_is_video_sequence_header(const RsRtmpMessage &msg);
+
+// aac audio specific config
+bool rs_rtmp_is_audio_sequence_header(const RsRtmpMessage &msg);
+
+// the @setDataFrame of publisher is not for the players, which get onMetaData and
+// the rest as is, the payload is sliced and not copied
+void rs_rtmp_remove_set_data_frame(RsRtmpMessage &msg);
+
+// the first amf0 string of a data message, such as onMetaData, empty if none
+std::string rs_rtmp_get_data_name(const RsRtmpMessage &msg);
+
+// protocol control message of one 4 bytes value, like set chunk size
+RsRtmpMessage rs_rtmp_create_control_message(uint8_t type_id, uint32_t value);
+
+// the 4 bytes value of a protocol control message
+int rs_rtmp_decode_control_message(const RsRtmpMessage &msg, uint32_t &value);
+
+// the limit type of set peer bandwidth
+#define RS_RTMP_PEER_BANDWIDTH_HARD 0
+#define RS_RTMP_PEER_BANDWIDTH_SOFT 1
+#define RS_RTMP_PEER_BANDWIDTH_DYNAMIC 2
+
+// set peer bandwidth, the window size and 1 byte of limit type
+RsRtmpMessage rs_rtmp_create_set_peer_bandwidth(uint32_t window, uint8_t limit_type);
+
+// user control message of 2 bytes event and 4 bytes value, like stream begin
+RsRtmpMessage rs_rtmp_create_user_control(uint16_t event, uint32_t value);
+
+/**
+ * amf0 command, the name and transaction id then any values,
+ * the first of which is the command object or null.
+ */
+class RsRtmpCommand {
+public:
+    std::string name;
+    double transaction_id;
+    std::vector<std::shared_ptr<RsAmf0Package>> values;
+public:
+    RsRtmpCommand() : transaction_id(0) {};
+
+    ~RsRtmpCommand() = default;
+
+public:
+    int initialize(const RsRtmpMessage &msg);
+
+    // the value is owned by the command
+    void add(RsAmf0Package *value);
+
+    // the index-th value, null if not there
+    RsAmf0Package *get(size_t index);
+
+    // a message on the command chunk stream
+    RsRtmpMessage dump(uint32_t stream_id);
+};
+
+/**
+ * what is known of one chunk stream, the headers of later chunks inherit from it
+ */
+struct RsRtmpChunkStream {
+    bool has_header;
+    bool extended;
+    uint32_t timestamp;
+    uint32_t timestamp_delta;
+    uint32_t message_length;
+    uint8_t type_id;
+    uint32_t stream_id;
+    // the message being assembled, the block holds the whole message
+    std::shared_ptr<char> block;
+    uint32_t received;
+
+    RsRtmpChunkStream() : has_header(false), extended(false), timestamp(0), timestamp_delta(0),
+                          message_length(0), type_id(0), stream_id(0), received(0) {}
+};
+
+/**
+ * the state of the chunk streams of one connection by cs_id. most peers only use
+ * the cs_id below 64, which have a 1 byte basic header, so they are kept in a
+ * flat array and only the rest is hashed.
+ */
+template<typename T>
+class RsRtmpChunkStreamTable {
+private:
+    T _low[64];
+    std::unordered_map<uint32_t, T> _high;
+public:
+    T &get(uint32_t cs_id) {
+        if (cs_id < 64) {
+            return _low[cs_id];
+        }
+        return _high[cs_id];
+    }
+};
+
+/**
+ * resumable decoder of the chunk stream of one connection.
+ * the bytes are fed as they are read, a header split over two reads is kept in a
+ * small scratch, otherwise headers are parsed in place and payloads are copied
+ * once into a block of the message length from the buffer pool of the loop.
+ */
+class RsRtmpChunkMsgAsync : public IRsAsyncMsg {
 private:
     enum {
-        rs_rtmp_chunk_header_uninitialized = 0,
-        rs_rtmp_chunk_header_completed
+        rs_rtmp_chunk_basic_header = 0,
+        rs_rtmp_chunk_basic_header_ext,
+        rs_rtmp_chunk_message_header,
+        rs_rtmp_chunk_extended_timestamp,
+        rs_rtmp_chunk_payload
     } _status;
-    // chunk size
+
     uint32_t _chunk_size;
-    // basic header
+    uint32_t _max_message_size;
+    std::shared_ptr<RsBufferPool> _buffer_pool;
+
+    // a header part not complete in the last read, at most 11 bytes
+    char _scratch[16];
+    size_t _scratch_size;
+
+    // the chunk being decoded
     uint8_t _fmt;
     uint32_t _cs_id;
-    // message header
-    uint32_t _timestamp;
-    uint32_t _message_length;
-    uint8_t _message_type_id;
-    uint32_t _message_stream_id;
-    // type 1, 2
-    uint32_t _timestamp_delta;
-    // extended timestamp
-    uint32_t _extended_timestamp;
-public:
-    RsRtmpChunkHeaderAsync() : _status(rs_rtmp_chunk_header_uninitialized) {};
+    uint32_t _timestamp_field;
+    RsRtmpChunkStream *_stream;
+    uint32_t _chunk_left;
 
-    virtual ~RsRtmpChunkHeaderAsync() override = default;
+    RsRtmpChunkStreamTable<RsRtmpChunkStream> _streams;
 
+    rtmp_message_cb _message_cb;
+    void *_message_param;
 public:
-    bool is_completed();
+    RsRtmpChunkMsgAsync();
+
+    virtual ~RsRtmpChunkMsgAsync() override = default;
+
+private:
+    // n contiguous bytes of the current header part, or null to wait for more
+    const char *gather(const char *&buf, size_t &size, size_t n);
+
+    int on_basic_header();
+
+    int on_message_header(const char *p);
+
+    int on_header_completed();
+
+    int on_message_completed();
 
 public:
-    int on_msg(std::vector<uint8_t> &buf) override;
+    void set_message_cb(rtmp_message_cb cb, void *param);
+
+    // the chunk size of peer, applies from the next chunk
+    void set_chunk_size(uint32_t chunk_size);
+
+    uint32_t get_chunk_size() { return _chunk_size; }
+
+    // the longer messages are refused before any memory is allocated for them
+    void set_max_message_size(uint32_t max_message_size);
+
+    int on_msg(const char *buf, size_t size) override;
 };
 
-class RsRtmpChunkMsgAsync : public IRsAsyncMsg {
+// the headers of the messages sent by one connection are carved from blocks of this size
+#define RS_RTMP_HEADER_ARENA_SIZE 4096
+
+/**
+ * the chunks of a message except the first header: the payload of the first
+ * chunk, then the type 3 header and payload of every other chunk. they only
+ * depend on the chunk size and the cs_id, so one copy is shared by every
+ * connection sending the message.
+ */
+struct RsRtmpChunkBody {
+    uint32_t chunk_size;
+    uint32_t cs_id;
+    // the type 3 headers carry the extended timestamp
+    bool extended;
+    std::vector<RsSharedSlice> slices;
+    size_t bytes;
+};
+
+/**
+ * a message sent to many connections, the payload is immutable and the chunks
+ * are encoded once for each chunk size and cs_id they are sent with.
+ * the producer frames the body most connections use before the message is
+ * shared, so they read it without lock.
+ */
+class RsRtmpSharedMessage {
 private:
-    enum {
-        rs_rtmp_chunk_message_uninitialized = 0,
-        rs_rtmp_chunk_message_header_created,
-        rs_rtmp_chunk_message_completed
-    } _status;
+    RsRtmpMessage _msg;
 
-    RsRtmpChunkHeaderAsync _header;
+    // set before shared, never changed after
+    std::shared_ptr<RsRtmpChunkBody> _framed;
 
-    // chunk data
-    std::vector<uint8_t> _chunked_data;
+    // the other chunk sizes, a few entries at most, the connections on other loops
+    // may look up concurrently
+    std::mutex _mutex;
+    std::vector<std::shared_ptr<RsRtmpChunkBody>> _bodies;
+public:
+    explicit RsRtmpSharedMessage(RsRtmpMessage msg);
+
+    ~RsRtmpSharedMessage() = default;
 
-    // for cache
-    // std::vector<uint8_t> _cache_buffer;
-    RsBufferLittleEndian _cache_buffer;
 public:
-    RsRtmpChunkMsgAsync() : _status(rs_rtmp_chunk_message_uninitialized) {};
+    const RsRtmpMessage &get_message() const { return _msg; }
 
-    virtual ~RsRtmpChunkMsgAsync() override = default;
+    // by the producer before the message is shared, the type 3 headers come from pool
+    void frame(uint32_t chunk_size, RsBufferPool *pool);
+
+    // the framed body, or encoded on first use
+    std::shared_ptr<RsRtmpChunkBody> get_body(uint32_t chunk_size, bool extended, RsBufferPool *pool);
+};
 
+/**
+ * the last header sent on one chunk stream, the next header only carries what changed
+ */
+struct RsRtmpOutChunkStream {
+    bool has_header;
+    // the delta of a type 3 chunk starting a message is clear only after type 1 or 2
+    bool has_delta;
+    bool extended;
+    uint32_t timestamp;
+    uint32_t timestamp_delta;
+    uint32_t message_length;
+    uint8_t type_id;
+    uint32_t stream_id;
+
+    RsRtmpOutChunkStream() : has_header(false), has_delta(false), extended(false), timestamp(0),
+                             timestamp_delta(0), message_length(0), type_id(0), stream_id(0) {}
+};
+
+/**
+ * serializes rtmp messages into chunks without copying the payload.
+ * the output is the list of header and payload slices in wire order, which is
+ * handed to the writer as is and sent by one writev. the headers are written
+ * into small arena blocks shared by the messages of the connection.
+ * the first header of a message is the smallest type the last header sent on
+ * its cs_id allows, the rest of the chunks are type 3.
+ */
+class RsRtmpChunkEncoder {
+private:
+    uint32_t _chunk_size;
+    std::shared_ptr<RsBufferPool> _buffer_pool;
+
+    std::shared_ptr<char> _arena;
+    size_t _arena_used;
+
+    RsRtmpChunkStreamTable<RsRtmpOutChunkStream> _streams;
 public:
+    RsRtmpChunkEncoder();
+
+    ~RsRtmpChunkEncoder() = default;
+
+private:
+    // n bytes of the arena, the block is referenced by the slices cut from it
+    char *alloc_headers(size_t n);
+
+    // the first header of msg, returns its size and whether it has extended timestamp
+    size_t encode_first_header(const RsRtmpMessage &msg, std::vector<RsSharedSlice> &slices,
+                               bool &extended);
+
+public:
+    // our chunk size, the peer must be told by set chunk size first
+    void set_chunk_size(uint32_t chunk_size);
+
+    uint32_t get_chunk_size() { return _chunk_size; }
 
-    bool is_completed();
+    // append the chunks of msg to slices, returns the bytes appended
+    size_t encode(const RsRtmpMessage &msg, std::vector<RsSharedSlice> &slices);
 
-    void clear();
+    // same, but only the first header is encoded for this connection
+    size_t encode(RsRtmpSharedMessage &msg, std::vector<RsSharedSlice> &slices);
 
-    int on_msg(std::vector<uint8_t> &buf) override;
+    // msg was sent in chunks of a type 0 header framed by another encoder of same
+    // chunk size, the next header on its cs_id follows from it
+    void on_framed(const RsRtmpMessage &msg);
 };
 
 #endif
@@ -0,0 +1,124 @@
+/*
+MIT License
+
+Copyright (c) 2016 ME_Kun_Han
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "gtest/gtest.h"
+#include "rs_kernel_pool.h"
+#include "rs_kernel_loop.h"
+#include "rs_kernel_io.h"
+
+TEST(RsObjectPool, allocate_release) {
+    RsObjectPool<uv_write_t> pool(4);
+    ASSERT_EQ(pool.live(), 0);
+    ASSERT_EQ(pool.pooled(), 0);
+
+    std::vector<uv_write_t *> reqs;
+    for (int i = 0; i < 6; i++) {
+        reqs.push_back(pool.allocate());
+    }
+    ASSERT_EQ(pool.live(), 6);
+    ASSERT_EQ(pool.pooled(), 2);
+
+    // released objects are handed out again
+    uv_write_t *last = reqs.back();
+    reqs.pop_back();
+    pool.release(last);
+    ASSERT_EQ(pool.live(), 5);
+    ASSERT_EQ(pool.pooled(), 3);
+    ASSERT_EQ(pool.allocate(), last);
+
+    for (auto req : reqs) {
+        pool.release(req);
+    }
+    pool.release(last);
+    ASSERT_EQ(pool.live(), 0);
+    ASSERT_EQ(pool.pooled(), 8);
+}
+
+TEST(RsLoop, socket_pool) {
+    auto loop = RsLoop::get_instance();
+    ASSERT_EQ(RsLoop::from(loop->get_uv_loop()), loop);
+
+    auto &pool = loop->get_pool<uv_tcp_t>();
+    size_t live = pool.live();
+
+    {
+        RsTCPSocketIO io[3];
+        ASSERT_EQ(pool.live(), live + 3);
+    }
+    ASSERT_EQ(pool.live(), live);
+    ASSERT_TRUE(pool.pooled() >= 3);
+    ASSERT_TRUE(loop->get_pooled_count() >= pool.pooled());
+}
+
+TEST(RsLoop, teardown) {
+    struct RsUtestCheck : public IRsLoopCheck {
+        int called = 0;
+
+        void on_loop_check() override { called++; }
+    } check;
+
+    uv_loop_t uv_loop{};
+    ASSERT_EQ(uv_loop_init(&uv_loop), 0);
+
+    // the handles of the loop are closed with it, even with checks pending
+    auto loop = new RsLoop(&uv_loop);
+    loop->schedule_check(&check);
+    delete loop;
+
+    uv_run(&uv_loop, UV_RUN_DEFAULT);
+    ASSERT_EQ(check.called, 0);
+    ASSERT_EQ(uv_loop_close(&uv_loop), 0);
+}
+
+TEST(RsBufferPool, size_classes) {
+    auto pool = std::make_shared<RsBufferPool>();
+
+    {
+        auto a = pool->allocate(100);
+        auto b = pool->allocate(200 * 1024);
+        ASSERT_EQ(pool->live(), 2);
+        ASSERT_EQ(pool->pooled(), 0);
+
+        // released blocks are reused by the sizes of the same class
+        char *p = b.get();
+        b.reset();
+        ASSERT_EQ(pool->live(), 1);
+        ASSERT_EQ(pool->pooled(), 1);
+        b = pool->allocate(150 * 1024);
+        ASSERT_EQ(b.get(), p);
+        ASSERT_EQ(pool->pooled(), 0);
+
+        // beyond the biggest class is not pooled
+        auto c = pool->allocate(32 * 1024 * 1024);
+        ASSERT_EQ(pool->live(), 2);
+    }
+    ASSERT_EQ(pool->live(), 0);
+    ASSERT_EQ(pool->pooled(), 2);
+
+    // dropped on another thread, the block is freed
+    auto d = pool->allocate(100);
+    std::thread([&d]() { d.reset(); }).join();
+    ASSERT_EQ(pool->live(), 0);
+    ASSERT_EQ(pool->pooled(), 1);
+}
@@ -0,0 +1,136 @@
+/*
+MIT License
+
+Copyright (c) 2016 ME_Kun_Han
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <thread>
+#include "gtest/gtest.h"
+#include "rs_kernel_queue.h"
+
+TEST(RsMPSCQueue, push_pop) {
+    RsMPSCQueue<int> queue;
+
+    int value = 0;
+    ASSERT_FALSE(queue.pop(value));
+
+    queue.push(1);
+    queue.push(2);
+    ASSERT_TRUE(queue.pop(value));
+    ASSERT_EQ(value, 1);
+    ASSERT_TRUE(queue.pop(value));
+    ASSERT_EQ(value, 2);
+    ASSERT_FALSE(queue.pop(value));
+
+    // the items left are freed with the queue
+    queue.push(3);
+}
+
+TEST(RsMPSCQueue, producers) {
+    const int producers = 4;
+    const int items = 10000;
+
+    RsMPSCQueue<int> queue;
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < producers; i++) {
+        threads.emplace_back([&queue, i]() {
+            for (int j = 0; j < items; j++) {
+                queue.push(i * items + j);
+            }
+        });
+    }
+
+    // every item is popped once, in order for each producer
+    std::vector<int> last(producers, -1);
+    int popped = 0;
+    while (popped < producers * items) {
+        int value;
+        if (!queue.pop(value)) {
+            continue;
+        }
+
+        auto producer = value / items;
+        ASSERT_GT(value % items, last[producer]);
+        last[producer] = value % items;
+        popped++;
+    }
+
+    for (auto &i : threads) {
+        i.join();
+    }
+
+    int value;
+    ASSERT_FALSE(queue.pop(value));
+}
+
+TEST(RsSPSCQueue, bounded) {
+    RsSPSCQueue<int> queue(3);
+    ASSERT_EQ(queue.capacity(), 4);
+
+    for (int i = 0; i < 4; i++) {
+        ASSERT_TRUE(queue.push(i));
+    }
+    ASSERT_FALSE(queue.push(4));
+    ASSERT_EQ(queue.size(), 4);
+
+    // wraps around
+    int value = 0;
+    ASSERT_TRUE(queue.pop(value));
+    ASSERT_EQ(value, 0);
+    ASSERT_TRUE(queue.push(4));
+
+    for (int i = 1; i <= 4; i++) {
+        ASSERT_TRUE(queue.pop(value));
+        ASSERT_EQ(value, i);
+    }
+    ASSERT_FALSE(queue.pop(value));
+    ASSERT_EQ(queue.size(), 0);
+}
+
+TEST(RsSPSCQueue, producer) {
+    const int items = 100000;
+
+    RsSPSCQueue<std::shared_ptr<int>> queue(64);
+
+    std::thread producer([&queue]() {
+        for (int i = 0; i < items; i++) {
+            auto value = std::make_shared<int>(i);
+            while (!queue.push(std::move(value))) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    // every item in order, released by the consumer
+    std::shared_ptr<int> value;
+    for (int i = 0; i < items;) {
+        if (!queue.pop(value)) {
+            continue;
+        }
+
+        ASSERT_EQ(*value, i);
+        ASSERT_EQ(value.use_count(), 1);
+        i++;
+    }
+
+    producer.join();
+    ASSERT_FALSE(queue.pop(value));
+}
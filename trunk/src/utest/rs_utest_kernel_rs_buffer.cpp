@@ -104,3 +104,95 @@ TEST(RsBuffer, read_write) {
     }
 
 }
+
+TEST(RsBuffer, cursor_reuse) {
+    RsBufferLittleEndian buffer;
+
+    // consume while writing, the block should be reused instead of growing
+    std::string chunk = rs_get_random(1000);
+    for (int i = 0; i < 100; i++) {
+        ASSERT_EQ(buffer.write_bytes(chunk), ERROR_SUCCESS);
+        ASSERT_EQ(buffer.length(), 1000);
+        ASSERT_TRUE(buffer.read_bytes(600) == chunk.substr(0, 600));
+        ASSERT_TRUE(buffer.read_bytes(400) == chunk.substr(600));
+        ASSERT_EQ(buffer.length(), 0);
+    }
+    size_t capacity = buffer.capacity();
+
+    // keep some unread bytes so the block has to be compacted
+    for (int i = 0; i < 100; i++) {
+        ASSERT_EQ(buffer.write_bytes(chunk), ERROR_SUCCESS);
+        ASSERT_EQ(buffer.read_bytes(900).size(), 900);
+        ASSERT_EQ(buffer.read_bytes(100), chunk.substr(900));
+    }
+    ASSERT_EQ(capacity, buffer.capacity());
+
+    // unread bytes survive the compaction
+    ASSERT_EQ(buffer.write_bytes(chunk), ERROR_SUCCESS);
+    buffer.read_bytes(10);
+    ASSERT_EQ(buffer.write_4_byte(0x01020304), ERROR_SUCCESS);
+    ASSERT_EQ(buffer.dump(), chunk.substr(10) + std::string("\x01\x02\x03\x04"));
+    buffer.read_bytes(990);
+    ASSERT_EQ(buffer.read_4_byte(), 0x01020304);
+    ASSERT_EQ(buffer.length(), 0);
+
+    // grow when the unread bytes do not fit
+    std::string big = rs_get_random(3 * 4096);
+    ASSERT_EQ(buffer.write_bytes(big), ERROR_SUCCESS);
+    ASSERT_EQ(buffer.dump(), big);
+}
+
+TEST(RsBuffer, slice_read_peek) {
+    RsBufferLittleEndian buffer;
+    std::string data = "hello rtmp server";
+    ASSERT_EQ(buffer.write(data.c_str(), (int) data.size()), ERROR_SUCCESS);
+
+    RsSlice slice;
+    ASSERT_EQ(buffer.peek(slice, 5), ERROR_SUCCESS);
+    ASSERT_EQ(slice.to_string(), "hello");
+    ASSERT_EQ(buffer.length(), data.size());
+
+    ASSERT_EQ(buffer.read(slice, 6), ERROR_SUCCESS);
+    ASSERT_EQ(slice.to_string(), "hello ");
+    ASSERT_EQ(buffer.length(), data.size() - 6);
+
+    // not enough bytes, nothing consumed
+    ASSERT_EQ(buffer.read(slice, 100), ERROR_KERNEL_BUFFER_NOT_ENOUGH);
+    ASSERT_EQ(buffer.length(), data.size() - 6);
+
+    std::string rest;
+    ASSERT_EQ(buffer.read(rest, (int) buffer.length()), ERROR_SUCCESS);
+    ASSERT_EQ(rest, "rtmp server");
+}
+
+TEST(RsBuffer, big_endian_codec) {
+    char bytes[8] = {0};
+
+    rs_write_be<uint16_t>(bytes, 0x0102);
+    ASSERT_EQ(std::string(bytes, 2), std::string("\x01\x02", 2));
+    ASSERT_EQ(rs_read_be<uint16_t>(bytes), 0x0102);
+
+    rs_write_be24(bytes, 0x00ABCDEF);
+    ASSERT_EQ(std::string(bytes, 3), std::string("\xAB\xCD\xEF", 3));
+    ASSERT_EQ(rs_read_be24(bytes), 0x00ABCDEF);
+
+    rs_write_be<uint32_t>(bytes, 0x01020304);
+    ASSERT_EQ(std::string(bytes, 4), std::string("\x01\x02\x03\x04", 4));
+    ASSERT_EQ(rs_read_be<uint32_t>(bytes), 0x01020304);
+
+    rs_write_be<uint64_t>(bytes, 0x0102030405060708);
+    ASSERT_EQ(std::string(bytes, 8), std::string("\x01\x02\x03\x04\x05\x06\x07\x08", 8));
+    ASSERT_EQ(rs_read_be<uint64_t>(bytes), 0x0102030405060708);
+
+    // ieee-754 of 1.0
+    rs_write_be<double>(bytes, 1.0);
+    ASSERT_EQ(std::string(bytes, 8), std::string("\x3F\xF0\x00\x00\x00\x00\x00\x00", 8));
+    ASSERT_EQ(rs_read_be<double>(bytes), 1.0);
+
+    RsBufferLittleEndian buffer;
+    ASSERT_EQ(buffer.write<double>(3.5), ERROR_SUCCESS);
+    ASSERT_EQ(buffer.write<uint16_t>(0xBEEF), ERROR_SUCCESS);
+    ASSERT_EQ(buffer.read<double>(), 3.5);
+    ASSERT_EQ(buffer.read<uint16_t>(), 0xBEEF);
+    ASSERT_EQ(RsBufferLittleEndian::convert_3bytes_into_uint32("\x00\x01\x00"), 256);
+}
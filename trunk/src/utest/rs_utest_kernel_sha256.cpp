@@ -0,0 +1,86 @@
+/*
+MIT License
+
+Copyright (c) 2016 ME_Kun_Han
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "rs_kernel_sha256.h"
+#include "gtest/gtest.h"
+
+using namespace std;
+
+static string to_hex(const uint8_t *digest) {
+    static const char *hex = "0123456789abcdef";
+    string s;
+    for (int i = 0; i < RS_SHA256_DIGEST_SIZE; i++) {
+        s += hex[digest[i] >> 4];
+        s += hex[digest[i] & 0x0f];
+    }
+    return s;
+}
+
+static string sha256(const string &data, size_t step) {
+    RsSha256 sha;
+    for (size_t pos = 0; pos < data.size(); pos += step) {
+        sha.update(data.data() + pos, std::min(step, data.size() - pos));
+    }
+
+    uint8_t digest[RS_SHA256_DIGEST_SIZE];
+    sha.final(digest);
+    return to_hex(digest);
+}
+
+TEST(RsSha256, digest) {
+    ASSERT_EQ("e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855", sha256("", 1));
+    ASSERT_EQ("ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad", sha256("abc", 1));
+
+    // the updates may split the blocks anywhere
+    string text = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    for (size_t step : {(size_t) 1, (size_t) 7, (size_t) 64, text.size()}) {
+        ASSERT_EQ("248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1", sha256(text, step));
+    }
+
+    ASSERT_EQ("cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0",
+              sha256(string(1000000, 'a'), 4096));
+}
+
+TEST(RsHmacSha256, sign) {
+    uint8_t digest[RS_SHA256_DIGEST_SIZE];
+
+    // the test cases 1, 2 and 6 of rfc 4231
+    string key(20, '\x0b');
+    RsHmacSha256(key.data(), key.size()).sign("Hi There", 8, digest);
+    ASSERT_EQ("b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7", to_hex(digest));
+
+    RsHmacSha256 jefe("Jefe", 4);
+    RsSlice parts[2] = {RsSlice("what do ya want ", 16), RsSlice("for nothing?", 12)};
+    jefe.sign(parts, 2, digest);
+    ASSERT_EQ("5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843", to_hex(digest));
+
+    // the pad states are reused by the next signature
+    jefe.sign("what do ya want for nothing?", 28, digest);
+    ASSERT_EQ("5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843", to_hex(digest));
+
+    string long_key(131, '\xaa');
+    string text = "Test Using Larger Than Block-Size Key - Hash Key First";
+    RsHmacSha256(long_key.data(), long_key.size()).sign(text.data(), text.size(), digest);
+    ASSERT_EQ("60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54", to_hex(digest));
+}
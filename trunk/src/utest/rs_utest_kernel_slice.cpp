@@ -0,0 +1,46 @@
+/*
+MIT License
+
+Copyright (c) 2016 ME_Kun_Han
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "gtest/gtest.h"
+#include "rs_kernel_slice.h"
+
+TEST(RsSharedSlice, share) {
+    std::string data = "hello rtmp server";
+
+    RsSharedSlice slice = RsSharedSlice::copy_from(data.c_str(), data.size());
+    ASSERT_EQ(slice.size(), data.size());
+    ASSERT_EQ(slice.view().to_string(), data);
+    ASSERT_EQ(slice.use_count(), 1);
+
+    {
+        RsSharedSlice sub = slice.sub(6, 4);
+        ASSERT_EQ(sub.view().to_string(), "rtmp");
+        ASSERT_EQ(sub.data(), slice.data() + 6);
+        ASSERT_EQ(slice.use_count(), 2);
+    }
+    ASSERT_EQ(slice.use_count(), 1);
+
+    RsSharedSlice empty;
+    ASSERT_TRUE(empty.empty());
+}
@@ -0,0 +1,141 @@
+/*
+MIT License
+
+Copyright (c) 2016 ME_Kun_Han
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "gtest/gtest.h"
+#include "rs_kernel_timer.h"
+#include "rs_kernel_loop.h"
+
+struct RsTimerRecord {
+    std::vector<int> fired;
+};
+
+TEST(RsTimingWheel, levels) {
+    auto wheel = RsLoop::get_instance()->get_timing_wheel();
+    auto base = uv_now(RsLoop::get_instance()->get_uv_loop());
+
+    RsTimerRecord record;
+
+    // one timer for each level of the wheel
+    std::vector<uint64_t> timeouts = {30, 2560 + 50, 163840 + 70, 10485760 + 90};
+    std::vector<std::unique_ptr<RsTimer>> timers;
+    for (size_t i = 0; i < timeouts.size(); i++) {
+        timers.emplace_back(new RsTimer());
+        auto id = static_cast<int>(i);
+        timers[i]->set_callback([&record, id](void *) { record.fired.push_back(id); }, nullptr);
+        timers[i]->start(timeouts[i]);
+    }
+    ASSERT_EQ(wheel->get_count(), 4);
+
+    for (size_t i = 0; i < timeouts.size(); i++) {
+        // not fired a tick early
+        wheel->advance(base + timeouts[i] - RS_TIMER_TICK_MS);
+        ASSERT_EQ(record.fired.size(), i);
+
+        wheel->advance(base + timeouts[i]);
+        ASSERT_EQ(record.fired.size(), i + 1);
+        ASSERT_EQ(record.fired.back(), (int) i);
+        ASSERT_FALSE(timers[i]->is_started());
+    }
+
+    ASSERT_EQ(wheel->get_count(), 0);
+}
+
+TEST(RsTimingWheel, cancel_restart) {
+    auto wheel = RsLoop::get_instance()->get_timing_wheel();
+    auto base = uv_now(RsLoop::get_instance()->get_uv_loop());
+
+    int fired = 0;
+    RsTimer cancelled, restarted, repeated;
+    cancelled.set_callback([&fired](void *) { fired += 100; }, nullptr);
+    restarted.set_callback([&fired](void *) { fired += 10; }, nullptr);
+    repeated.set_callback([&fired, &repeated](void *) {
+        // started again from its own callback
+        if (++fired < 3) {
+            repeated.start(100);
+        }
+    }, nullptr);
+
+    cancelled.start(50);
+    restarted.start(50);
+    repeated.start(100);
+
+    cancelled.cancel();
+    restarted.start(1000);
+    ASSERT_EQ(wheel->get_count(), 2);
+
+    wheel->advance(base + 300);
+    ASSERT_EQ(fired, 3);
+
+    wheel->advance(base + 1000);
+    ASSERT_EQ(fired, 13);
+    ASSERT_EQ(wheel->get_count(), 0);
+
+    {
+        RsTimer gone;
+        gone.start(10);
+        ASSERT_EQ(wheel->get_count(), 1);
+    }
+    ASSERT_EQ(wheel->get_count(), 0);
+}
+
+TEST(RsTimingWheel, random_timeouts) {
+    auto wheel = RsLoop::get_instance()->get_timing_wheel();
+    auto base = uv_now(RsLoop::get_instance()->get_uv_loop());
+
+    struct Item {
+        RsTimer timer;
+        uint64_t expect;
+        uint64_t fired_at;
+    };
+
+    uint64_t now = base;
+    srand(1935);
+
+    std::vector<std::unique_ptr<Item>> items;
+    for (int i = 0; i < 2000; i++) {
+        items.emplace_back(new Item());
+        auto item = items.back().get();
+        auto timeout = static_cast<uint64_t>(rand() % 3000000);
+        item->expect = base + (timeout + RS_TIMER_TICK_MS - 1) / RS_TIMER_TICK_MS * RS_TIMER_TICK_MS;
+        item->fired_at = 0;
+        item->timer.set_callback([item, &now](void *) { item->fired_at = now; }, nullptr);
+        item->timer.start(timeout);
+    }
+
+    // every timer fires at the step containing its expire tick
+    while (wheel->get_count() > 0) {
+        auto last = now;
+        now += RS_TIMER_TICK_MS * (1 + rand() % 500);
+        wheel->advance(now);
+
+        for (auto &item : items) {
+            if (item->expect > last && item->expect <= now) {
+                ASSERT_EQ(item->fired_at, now);
+            }
+        }
+    }
+
+    for (auto &item : items) {
+        ASSERT_NE(item->fired_at, 0);
+    }
+}
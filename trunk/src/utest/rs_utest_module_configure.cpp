@@ -24,7 +24,128 @@ SOFTWARE.
 
 #include "gtest/gtest.h"
 #include "rs_module_config.h"
+#include "rs_utest_utility.h"
 
 TEST(RS_CONFIG, demo) {
     EXPECT_TRUE(true);
-}
\ No newline at end of file
+}
+
+TEST(RS_CONFIG, rtmp_server) {
+    {
+        rs_config::RsConfig config;
+        std::string path = rs_utest_write_config_file(
+                "{\"server\": [{\"name\": \"s1\", \"type\": \"rtmp\", \"listen\": 1935,"
+                "\"rtmp-server\": {\"write_high_watermark\": 2048,"
+                "\"write_low_watermark\": 1024, \"max_message_size\": 65536,"
+                "\"out_chunk_size\": 4096, \"ack_window_size\": 1000000,"
+                "\"gop_cache_max_duration_ms\": 5000, \"gop_cache_max_bytes\": 0,"
+                "\"merged_write_ms\": 350, \"merged_write_messages\": 64,"
+                "\"consumer_queue_size\": 512}}]}");
+        ASSERT_EQ(config.initialize(path), ERROR_SUCCESS);
+
+        auto server = dynamic_cast<rs_config::RsConfigRTMPServer *>(
+                config.get_servers().at("s1").get());
+        ASSERT_TRUE(server != nullptr);
+        ASSERT_EQ(server->get_write_high_watermark(), 2048);
+        ASSERT_EQ(server->get_write_low_watermark(), 1024);
+        ASSERT_EQ(server->get_max_message_size(), 65536);
+        ASSERT_EQ(server->get_out_chunk_size(), 4096);
+        ASSERT_EQ(server->get_ack_window_size(), 1000000);
+        ASSERT_EQ(server->get_gop_cache_max_duration(), 5000);
+        ASSERT_EQ(server->get_gop_cache_max_bytes(), 0);
+        ASSERT_EQ(server->get_merged_write_window(), 350);
+        ASSERT_EQ(server->get_merged_write_messages(), 64);
+        ASSERT_EQ(server->get_consumer_queue_size(), 512);
+    }
+
+    {
+        rs_config::RsConfig config;
+        std::string path = rs_utest_write_config_file(
+                "{\"server\": [{\"name\": \"s1\", \"type\": \"rtmp\", \"listen\": 1935}]}");
+        ASSERT_EQ(config.initialize(path), ERROR_SUCCESS);
+
+        auto server = dynamic_cast<rs_config::RsConfigRTMPServer *>(
+                config.get_servers().at("s1").get());
+        ASSERT_EQ(server->get_write_high_watermark(), rs_config::DEFAULT_WRITE_HIGH_WATERMARK);
+        ASSERT_EQ(server->get_write_low_watermark(), rs_config::DEFAULT_WRITE_LOW_WATERMARK);
+        ASSERT_EQ(server->get_worker_threads(), rs_config::DEFAULT_SERVER_WORKER_THREADS);
+        ASSERT_EQ(server->get_max_message_size(), rs_config::DEFAULT_MAX_MESSAGE_SIZE);
+        ASSERT_EQ(server->get_out_chunk_size(), rs_config::DEFAULT_OUT_CHUNK_SIZE);
+        ASSERT_EQ(server->get_ack_window_size(), rs_config::DEFAULT_ACK_WINDOW_SIZE);
+        ASSERT_EQ(server->get_gop_cache_max_duration(), rs_config::DEFAULT_GOP_CACHE_MAX_DURATION);
+        ASSERT_EQ(server->get_gop_cache_max_bytes(), rs_config::DEFAULT_GOP_CACHE_MAX_BYTES);
+        ASSERT_EQ(server->get_merged_write_window(), rs_config::DEFAULT_MERGED_WRITE_WINDOW);
+        ASSERT_EQ(server->get_merged_write_messages(), rs_config::DEFAULT_MERGED_WRITE_MESSAGES);
+        ASSERT_EQ(server->get_consumer_queue_size(), rs_config::DEFAULT_CONSUMER_QUEUE_SIZE);
+    }
+
+    {
+        rs_config::RsConfig config;
+        std::string path = rs_utest_write_config_file(
+                "{\"server\": [{\"name\": \"s1\", \"type\": \"rtmp\", \"listen\": 1935,"
+                "\"worker_threads\": 4}]}");
+        ASSERT_EQ(config.initialize(path), ERROR_SUCCESS);
+        ASSERT_EQ(config.get_servers().at("s1")->get_worker_threads(), 4);
+        ASSERT_EQ(config.get_servers().at("s1")->get_listen_mode(),
+                  rs_config::RS_LISTEN_MODE_REUSEPORT);
+    }
+
+    {
+        rs_config::RsConfig config;
+        std::string path = rs_utest_write_config_file(
+                "{\"server\": [{\"name\": \"s1\", \"type\": \"rtmp\", \"listen\": 1935,"
+                "\"listen_mode\": \"dispatch\"}]}");
+        ASSERT_EQ(config.initialize(path), ERROR_SUCCESS);
+        ASSERT_EQ(config.get_servers().at("s1")->get_listen_mode(),
+                  rs_config::RS_LISTEN_MODE_DISPATCH);
+    }
+
+    {
+        rs_config::RsConfig config;
+        std::string path = rs_utest_write_config_file(
+                "{\"server\": [{\"name\": \"s1\", \"type\": \"rtmp\", \"listen\": 1935,"
+                "\"listen_mode\": \"round-robin\"}]}");
+        ASSERT_EQ(config.initialize(path), ERROR_CONFIGURE_SYNTAX_INVALID);
+    }
+
+    {
+        rs_config::RsConfig config;
+        std::string path = rs_utest_write_config_file(
+                "{\"server\": [{\"name\": \"s1\", \"type\": \"rtmp\", \"listen\": 1935,"
+                "\"worker_threads\": 0}]}");
+        ASSERT_EQ(config.initialize(path), ERROR_CONFIGURE_SYNTAX_INVALID);
+    }
+
+    {
+        rs_config::RsConfig config;
+        std::string path = rs_utest_write_config_file(
+                "{\"server\": [{\"name\": \"s1\", \"type\": \"rtmp\", \"listen\": 1935,"
+                "\"rtmp-server\": {\"write_high_watermark\": 1024,"
+                "\"write_low_watermark\": 2048}}]}");
+        ASSERT_EQ(config.initialize(path), ERROR_CONFIGURE_SYNTAX_INVALID);
+    }
+
+    {
+        rs_config::RsConfig config;
+        std::string path = rs_utest_write_config_file(
+                "{\"server\": [{\"name\": \"s1\", \"type\": \"rtmp\", \"listen\": 1935,"
+                "\"rtmp-server\": {\"out_chunk_size\": 100}}]}");
+        ASSERT_EQ(config.initialize(path), ERROR_CONFIGURE_SYNTAX_INVALID);
+    }
+
+    {
+        rs_config::RsConfig config;
+        std::string path = rs_utest_write_config_file(
+                "{\"server\": [{\"name\": \"s1\", \"type\": \"rtmp\", \"listen\": 1935,"
+                "\"rtmp-server\": {\"max_message_size\": 0}}]}");
+        ASSERT_EQ(config.initialize(path), ERROR_CONFIGURE_SYNTAX_INVALID);
+    }
+
+    {
+        rs_config::RsConfig config;
+        std::string path = rs_utest_write_config_file(
+                "{\"server\": [{\"name\": \"s1\", \"type\": \"rtmp\", \"listen\": 1935,"
+                "\"rtmp-server\": {\"merged_write_ms\": 501}}]}");
+        ASSERT_EQ(config.initialize(path), ERROR_CONFIGURE_SYNTAX_INVALID);
+    }
+}
@@ -0,0 +1,576 @@
+/*
+MIT License
+
+Copyright (c) 2016 ME_Kun_Han
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <unistd.h>
+#include <sys/socket.h>
+#include "gtest/gtest.h"
+#include "rs_module_server.h"
+#include "rs_utest_utility.h"
+
+/**
+ * the config of the servers, and the server s1 of it on the loop of this thread,
+ * which runs while the test waits
+ */
+class RsUtestServer : public testing::Test {
+protected:
+    uv_loop_t *loop = nullptr;
+    rs_config::RsConfig config;
+    std::unique_ptr<RsRtmpServer> server;
+
+protected:
+    void SetUp() override {
+        loop = RsLoop::get_instance()->get_uv_loop();
+    }
+
+    void TearDown() override {
+        if (server != nullptr) {
+            server->dispose();
+            uv_run(loop, UV_RUN_NOWAIT);
+            server.reset();
+        }
+    }
+
+    // the items of the server array
+    int load_config(const std::string &servers) {
+        return config.initialize(rs_utest_write_config_file("{\"server\": [" + servers + "]}"));
+    }
+
+    int start_server(const std::string &servers) {
+        int ret = ERROR_SUCCESS;
+
+        if ((ret = load_config(servers)) != ERROR_SUCCESS) {
+            return ret;
+        }
+
+        server.reset(new RsRtmpServer(0, nullptr));
+        return server->initialize(config.get_servers().at("s1").get());
+    }
+
+    void run_until(const std::function<bool()> &done) {
+        for (int i = 0; i < 1000 && !done(); i++) {
+            uv_run(loop, UV_RUN_NOWAIT);
+            usleep(1000);
+        }
+    }
+};
+
+TEST_F(RsUtestServer, start_stop) {
+    ASSERT_EQ(load_config("{\"name\": \"s1\", \"type\": \"rtmp\", \"listen\": 19351,"
+                          "\"worker_threads\": 2}"), ERROR_SUCCESS);
+
+    // both workers bind the port, which only works with SO_REUSEPORT
+    RsServerWorker first(0);
+    ASSERT_EQ(first.start(config.get_servers(), DispatcherContainer()), ERROR_SUCCESS);
+
+    RsServerWorker second(1);
+    ASSERT_EQ(second.start(config.get_servers(), DispatcherContainer()), ERROR_SUCCESS);
+
+    first.stop();
+    second.stop();
+
+    // the port is released by the stopped workers
+    RsServerWorker again(1);
+    ASSERT_EQ(again.start(config.get_servers(), DispatcherContainer()), ERROR_SUCCESS);
+    again.stop();
+}
+
+TEST(RsConnectionDispatcher, fewest_connections) {
+    RsConnectionDispatcher dispatcher(3);
+
+    RsRtmpServer first(0, nullptr), second(1, nullptr), third(2, nullptr);
+    dispatcher.attach(0, &first);
+    dispatcher.attach(1, &second);
+
+    uint32_t worker = 0;
+    ASSERT_EQ(dispatcher.pick(worker), &first);
+    ASSERT_EQ(worker, 0);
+    ASSERT_EQ(dispatcher.pick(worker), &second);
+    ASSERT_EQ(worker, 1);
+
+    // a worker without the server is skipped
+    dispatcher.attach(2, &third);
+    ASSERT_EQ(dispatcher.pick(worker), &third);
+    ASSERT_EQ(worker, 2);
+
+    dispatcher.on_connection_closed(1);
+    ASSERT_EQ(dispatcher.pick(worker), &second);
+    ASSERT_EQ(worker, 1);
+
+    dispatcher.detach(0);
+    dispatcher.on_connection_closed(0);
+    ASSERT_EQ(dispatcher.pick(worker), &second);
+
+    std::vector<int> counts = {0, 2, 1};
+    ASSERT_EQ(dispatcher.get_connection_counts(), counts);
+}
+
+TEST_F(RsUtestServer, dispatch) {
+    ASSERT_EQ(load_config("{\"name\": \"s1\", \"type\": \"rtmp\", \"listen\": 19356,"
+                          "\"worker_threads\": 2, \"listen_mode\": \"dispatch\"}"), ERROR_SUCCESS);
+
+    // worker 0 accepts on this thread, worker 1 runs its own
+    RsServerManager manager;
+    ASSERT_EQ(manager.initialize(config.get_servers()), ERROR_SUCCESS);
+
+    sockaddr_in addr{};
+    uv_ip4_addr("127.0.0.1", 19356, &addr);
+
+    int clients[4];
+    for (auto &client : clients) {
+        client = socket(AF_INET, SOCK_STREAM, 0);
+        ASSERT_EQ(connect(client, (sockaddr *) &addr, sizeof(addr)), 0);
+    }
+
+    // spread to the worker with the fewest connections
+    std::vector<int> counts = {2, 2};
+    run_until([&]() { return manager.get_connection_counts("s1") == counts; });
+    ASSERT_EQ(manager.get_connection_counts("s1"), counts);
+
+    for (auto client : clients) {
+        close(client);
+    }
+    counts = {0, 0};
+    run_until([&]() { return manager.get_connection_counts("s1") == counts; });
+    ASSERT_EQ(manager.get_connection_counts("s1"), counts);
+
+    manager.stop();
+    uv_run(loop, UV_RUN_NOWAIT);
+}
+
+TEST_F(RsUtestServer, reap_closed_connections) {
+    ASSERT_EQ(start_server("{\"name\": \"s1\", \"type\": \"rtmp\", \"listen\": 19352}"), ERROR_SUCCESS);
+
+    sockaddr_in addr{};
+    uv_ip4_addr("127.0.0.1", 19352, &addr);
+
+    int clients[3];
+    for (auto &client : clients) {
+        client = socket(AF_INET, SOCK_STREAM, 0);
+        ASSERT_EQ(connect(client, (sockaddr *) &addr, sizeof(addr)), 0);
+    }
+
+    run_until([this]() { return server->get_connection_count() == 3; });
+    ASSERT_EQ(server->get_connection_count(), 3);
+
+    // closed by the peer, removed without any polling
+    close(clients[1]);
+    run_until([this]() { return server->get_connection_count() == 2; });
+    ASSERT_EQ(server->get_connection_count(), 2);
+
+    // the slot is reused
+    clients[1] = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_EQ(connect(clients[1], (sockaddr *) &addr, sizeof(addr)), 0);
+    run_until([this]() { return server->get_connection_count() == 3; });
+    ASSERT_EQ(server->get_connection_count(), 3);
+
+    for (auto client : clients) {
+        close(client);
+    }
+    run_until([this]() { return server->get_connection_count() == 0; });
+    ASSERT_EQ(server->get_connection_count(), 0);
+}
+
+TEST_F(RsUtestServer, handshake_timeout) {
+    ASSERT_EQ(start_server("{\"name\": \"s1\", \"type\": \"rtmp\", \"listen\": 19353,"
+                           "\"rtmp-server\": {\"handshake_timeout_ms\": 100}}"), ERROR_SUCCESS);
+
+    sockaddr_in addr{};
+    uv_ip4_addr("127.0.0.1", 19353, &addr);
+
+    // connected, but never sends c0c1
+    int client = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_EQ(connect(client, (sockaddr *) &addr, sizeof(addr)), 0);
+
+    run_until([this]() { return server->get_connection_count() == 1; });
+    ASSERT_EQ(server->get_connection_count(), 1);
+
+    run_until([this]() { return server->get_connection_count() == 0; });
+    ASSERT_EQ(server->get_connection_count(), 0);
+
+    // closed by the server
+    char buf[1];
+    ASSERT_EQ(recv(client, buf, sizeof(buf), 0), 0);
+    close(client);
+}
+
+static void send_message(int client, RsRtmpChunkEncoder &encoder, const RsRtmpMessage &msg) {
+    std::vector<RsSharedSlice> slices;
+    encoder.encode(msg, slices);
+    for (auto &slice : slices) {
+        ASSERT_EQ(send(client, slice.data(), slice.size(), 0), (ssize_t) slice.size());
+    }
+}
+
+TEST_F(RsUtestServer, connect) {
+    ASSERT_EQ(start_server("{\"name\": \"s1\", \"type\": \"rtmp\", \"listen\": 19354,"
+                           "\"rtmp-server\": {\"out_chunk_size\": 4096, \"ack_window_size\": 100000}}"),
+              ERROR_SUCCESS);
+
+    sockaddr_in addr{};
+    uv_ip4_addr("127.0.0.1", 19354, &addr);
+    int client = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_EQ(connect(client, (sockaddr *) &addr, sizeof(addr)), 0);
+
+    // receive until done, the server runs on this thread
+    std::string received;
+    auto receive_until = [&](std::function<bool()> done) {
+        char buf[8192];
+        for (int i = 0; i < 1000 && !done(); i++) {
+            uv_run(loop, UV_RUN_NOWAIT);
+            auto n = recv(client, buf, sizeof(buf), MSG_DONTWAIT);
+            if (n > 0) {
+                received.append(buf, n);
+            } else {
+                usleep(1000);
+            }
+        }
+    };
+
+    std::string c0c1 = "\x03" + std::string(1536, '\0');
+    ASSERT_EQ(send(client, c0c1.data(), c0c1.size(), 0), (ssize_t) c0c1.size());
+    receive_until([&received]() { return received.size() >= 3073; });
+    ASSERT_EQ(received.size(), 3073);
+
+    // c2, then our chunk size and a connect bigger than the default chunk size
+    std::string c2 = received.substr(1, 1536);
+    ASSERT_EQ(send(client, c2.data(), c2.size(), 0), (ssize_t) c2.size());
+
+    RsRtmpChunkEncoder encoder;
+    send_message(client, encoder, rs_rtmp_create_control_message(RS_RTMP_MSG_SET_CHUNK_SIZE, 1024));
+    encoder.set_chunk_size(1024);
+    send_message(client, encoder, rs_rtmp_create_control_message(RS_RTMP_MSG_WINDOW_ACK_SIZE, 5000));
+
+    RsRtmpCommand connect_cmd;
+    connect_cmd.name = "connect";
+    connect_cmd.transaction_id = 1;
+    auto obj = new RsAmf0Object();
+    obj->set("app", new RsAmf0String("live"));
+    obj->set("tcUrl", new RsAmf0String("rtmp://127.0.0.1/live?" + std::string(300, 'x')));
+    connect_cmd.add(obj);
+    send_message(client, encoder, connect_cmd.dump(0));
+
+    // set chunk size then _result
+    RsRtmpChunkMsgAsync decoder;
+    std::vector<RsRtmpMessage> msgs;
+    decoder.set_message_cb([&decoder, &msgs](RsRtmpMessage &msg, void *) {
+        uint32_t value = 0;
+        if (msg.type_id == RS_RTMP_MSG_SET_CHUNK_SIZE &&
+            rs_rtmp_decode_control_message(msg, value) == ERROR_SUCCESS) {
+            decoder.set_chunk_size(value);
+        }
+        msgs.push_back(msg);
+        return ERROR_SUCCESS;
+    }, nullptr);
+
+    received.clear();
+    receive_until([&]() {
+        decoder.on_msg(received.data(), received.size());
+        received.clear();
+        return msgs.size() >= 4;
+    });
+    ASSERT_EQ(msgs.size(), 4);
+
+    uint32_t value = 0;
+    ASSERT_EQ(msgs[0].type_id, RS_RTMP_MSG_WINDOW_ACK_SIZE);
+    ASSERT_EQ(rs_rtmp_decode_control_message(msgs[0], value), ERROR_SUCCESS);
+    ASSERT_EQ(value, 100000);
+    ASSERT_EQ(msgs[1].type_id, RS_RTMP_MSG_SET_PEER_BANDWIDTH);
+    ASSERT_EQ(msgs[1].payload.size(), 5);
+    ASSERT_EQ(msgs[2].type_id, RS_RTMP_MSG_SET_CHUNK_SIZE);
+    ASSERT_EQ(rs_rtmp_decode_control_message(msgs[2], value), ERROR_SUCCESS);
+    ASSERT_EQ(value, 4096);
+
+    RsRtmpCommand result;
+    ASSERT_EQ(result.initialize(msgs[3]), ERROR_SUCCESS);
+    ASSERT_EQ(result.name, "_result");
+    ASSERT_EQ(result.transaction_id, 1);
+    auto info = dynamic_cast<RsAmf0Object *>(result.get(1));
+    ASSERT_TRUE(info != nullptr);
+    ASSERT_EQ(dynamic_cast<RsAmf0String *>(info->get("code"))->value, "NetConnection.Connect.Success");
+
+    // acknowledged once the window asked by us is received
+    RsRtmpMessage audio;
+    audio.cs_id = 4;
+    audio.timestamp = 0;
+    audio.type_id = RS_RTMP_MSG_AUDIO;
+    audio.stream_id = 1;
+    audio.payload = RsSharedSlice::copy_from(std::string(3000, 'a').data(), 3000);
+    send_message(client, encoder, audio);
+    send_message(client, encoder, audio);
+
+    msgs.clear();
+    receive_until([&]() {
+        decoder.on_msg(received.data(), received.size());
+        received.clear();
+        return !msgs.empty();
+    });
+    ASSERT_EQ(msgs.size(), 1);
+    ASSERT_EQ(msgs[0].type_id, RS_RTMP_MSG_ACKNOWLEDGEMENT);
+    ASSERT_EQ(rs_rtmp_decode_control_message(msgs[0], value), ERROR_SUCCESS);
+    ASSERT_TRUE(value > 1537 + 1536 + 6000);
+
+    close(client);
+    run_until([this]() { return server->get_connection_count() == 0; });
+    ASSERT_EQ(server->get_connection_count(), 0);
+}
+
+/**
+ * a client of the server running on this thread, the server runs while waiting
+ */
+struct RsUtestRtmpClient {
+    int fd;
+    uv_loop_t *loop;
+    RsRtmpChunkEncoder encoder;
+    RsRtmpChunkMsgAsync decoder;
+    std::vector<RsRtmpMessage> msgs;
+
+    explicit RsUtestRtmpClient(int port) {
+        loop = RsLoop::get_instance()->get_uv_loop();
+
+        sockaddr_in addr{};
+        uv_ip4_addr("127.0.0.1", port, &addr);
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        connect(fd, (sockaddr *) &addr, sizeof(addr));
+
+        decoder.set_message_cb([this](RsRtmpMessage &msg, void *) {
+            uint32_t value = 0;
+            if (msg.type_id == RS_RTMP_MSG_SET_CHUNK_SIZE &&
+                rs_rtmp_decode_control_message(msg, value) == ERROR_SUCCESS) {
+                decoder.set_chunk_size(value);
+            }
+            msgs.push_back(msg);
+            return ERROR_SUCCESS;
+        }, nullptr);
+    }
+
+    ~RsUtestRtmpClient() { close(fd); }
+
+    void receive_until(const std::function<bool()> &done, std::string *raw = nullptr) {
+        char buf[8192];
+        for (int i = 0; i < 1000 && !done(); i++) {
+            uv_run(loop, UV_RUN_NOWAIT);
+            auto n = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+            if (n <= 0) {
+                usleep(1000);
+            } else if (raw != nullptr) {
+                raw->append(buf, n);
+            } else {
+                decoder.on_msg(buf, n);
+            }
+        }
+    }
+
+    // handshake, connect to app and create the stream, the replies are cleared
+    void connect_app(const std::string &app) {
+        std::string c0c1 = "\x03" + std::string(1536, '\0');
+        ASSERT_EQ(send(fd, c0c1.data(), c0c1.size(), 0), (ssize_t) c0c1.size());
+
+        std::string s0s1s2;
+        receive_until([&s0s1s2]() { return s0s1s2.size() >= 3073; }, &s0s1s2);
+        ASSERT_EQ(s0s1s2.size(), 3073);
+        ASSERT_EQ(send(fd, s0s1s2.data() + 1, 1536, 0), 1536);
+
+        RsRtmpCommand connect_cmd;
+        connect_cmd.name = "connect";
+        connect_cmd.transaction_id = 1;
+        auto obj = new RsAmf0Object();
+        obj->set("app", new RsAmf0String(app));
+        connect_cmd.add(obj);
+        send_message(fd, encoder, connect_cmd.dump(0));
+        receive_until([this]() { return msgs.size() >= 4; });
+        ASSERT_EQ(msgs.size(), 4);
+
+        RsRtmpCommand create_stream;
+        create_stream.name = "createStream";
+        create_stream.transaction_id = 2;
+        create_stream.add(new RsAmf0Null());
+        send_message(fd, encoder, create_stream.dump(0));
+        receive_until([this]() { return msgs.size() >= 5; });
+        ASSERT_EQ(msgs.size(), 5);
+
+        RsRtmpCommand result;
+        ASSERT_EQ(result.initialize(msgs[4]), ERROR_SUCCESS);
+        ASSERT_EQ(result.name, "_result");
+        ASSERT_EQ(dynamic_cast<RsAmf0Number *>(result.get(1))->value, RS_RTMP_STREAM_ID);
+        msgs.clear();
+    }
+
+    // publish or play the stream
+    void start_stream(const std::string &command, const std::string &stream) {
+        RsRtmpCommand cmd;
+        cmd.name = command;
+        cmd.add(new RsAmf0Null());
+        cmd.add(new RsAmf0String(stream));
+        send_message(fd, encoder, cmd.dump(RS_RTMP_STREAM_ID));
+    }
+
+    // the code of the index-th message, which is onStatus
+    std::string get_status_code(size_t index) {
+        RsRtmpCommand status;
+        if (index >= msgs.size() || status.initialize(msgs[index]) != ERROR_SUCCESS ||
+            status.name != "onStatus") {
+            return "";
+        }
+
+        auto info = dynamic_cast<RsAmf0Object *>(status.get(1));
+        auto code = info ? dynamic_cast<RsAmf0String *>(info->get("code")) : nullptr;
+        return code ? code->value : "";
+    }
+};
+
+TEST_F(RsUtestServer, publish_play) {
+    ASSERT_EQ(start_server("{\"name\": \"s1\", \"type\": \"rtmp\", \"listen\": 19355}"), ERROR_SUCCESS);
+
+    {
+        RsUtestRtmpClient publisher(19355), player(19355), other(19355), second(19355);
+        publisher.connect_app("live");
+        player.connect_app("live");
+        second.connect_app("live?vhost=utest");
+        other.connect_app("live");
+
+        publisher.start_stream("publish", "stream?token=1");
+        publisher.receive_until([&publisher]() { return !publisher.msgs.empty(); });
+        ASSERT_EQ(publisher.get_status_code(0), "NetStream.Publish.Start");
+
+        // one publisher for one stream
+        other.start_stream("publish", "stream");
+        other.receive_until([&other]() { return !other.msgs.empty(); });
+        ASSERT_EQ(other.get_status_code(0), "NetStream.Publish.BadName");
+
+        // stream begin, reset and start
+        for (auto client : {&player, &second}) {
+            client->start_stream("play", "stream");
+            client->receive_until([client]() { return client->msgs.size() >= 3; });
+            ASSERT_EQ(client->msgs.size(), 3);
+            ASSERT_EQ(client->msgs[0].type_id, RS_RTMP_MSG_USER_CONTROL);
+            ASSERT_EQ(client->get_status_code(2), "NetStream.Play.Start");
+            client->msgs.clear();
+        }
+
+        RsRtmpMessage video;
+        video.cs_id = 4;
+        video.timestamp = 0;
+        video.type_id = RS_RTMP_MSG_VIDEO;
+        video.stream_id = RS_RTMP_STREAM_ID;
+        std::string sequence_header = std::string("\x17\x00", 2) + std::string(200, 's');
+        video.payload = RsSharedSlice::copy_from(sequence_header.data(), sequence_header.size());
+        send_message(publisher.fd, publisher.encoder, video);
+
+        std::string payload = std::string("\x17\x01", 2) + std::string(10000, 'v');
+        video.payload = RsSharedSlice::copy_from(payload.data(), payload.size());
+        video.timestamp = 40;
+        send_message(publisher.fd, publisher.encoder, video);
+        video.timestamp = 80;
+        send_message(publisher.fd, publisher.encoder, video);
+
+        for (auto client : {&player, &second}) {
+            client->receive_until([client]() { return client->msgs.size() >= 3; });
+            ASSERT_EQ(client->msgs.size(), 3);
+            ASSERT_EQ(client->msgs[2].type_id, RS_RTMP_MSG_VIDEO);
+            ASSERT_EQ(client->msgs[2].timestamp, 80);
+            ASSERT_EQ(client->msgs[2].stream_id, RS_RTMP_STREAM_ID);
+            ASSERT_EQ(client->msgs[2].payload.view().to_string(), payload);
+        }
+
+        // the time to first frame is taken by the keyframe, not the sequence header
+        int first_frames = 0;
+        for (auto &conn : server->get_connections()) {
+            first_frames += conn->get_time_to_first_frame() >= 0 ? 1 : 0;
+        }
+        ASSERT_EQ(first_frames, 2);
+
+        // a late player gets the framed sequence header and the last gop, then the next messages
+        RsUtestRtmpClient late(19355);
+        late.connect_app("live");
+        late.start_stream("play", "stream");
+        late.receive_until([&late]() { return late.msgs.size() >= 5; });
+        ASSERT_EQ(late.msgs.size(), 5);
+        ASSERT_EQ(late.msgs[3].payload.view().to_string(), sequence_header);
+        ASSERT_EQ(late.msgs[4].timestamp, 80);
+
+        video.timestamp = 120;
+        send_message(publisher.fd, publisher.encoder, video);
+        late.receive_until([&late]() { return late.msgs.size() >= 6; });
+        ASSERT_EQ(late.msgs.size(), 6);
+        ASSERT_EQ(late.msgs[5].timestamp, 120);
+        ASSERT_EQ(late.msgs[5].payload.view().to_string(), payload);
+
+        // the source lives while the player holds it
+        auto source = RsRtmpSourceManager::get_instance()->fetch("live/stream");
+        ASSERT_TRUE(source != nullptr);
+        close(publisher.fd);
+        publisher.fd = -1;
+        player.receive_until([&source]() { return !source->is_publishing(); });
+        ASSERT_FALSE(source->is_publishing());
+        ASSERT_EQ(source->get_consumer_count(), 3);
+    }
+
+    run_until([this]() { return server->get_connection_count() == 0; });
+    ASSERT_EQ(server->get_connection_count(), 0);
+    ASSERT_TRUE(RsRtmpSourceManager::get_instance()->fetch("live/stream") == nullptr);
+}
+
+TEST_F(RsUtestServer, ack_window) {
+    ASSERT_EQ(start_server("{\"name\": \"s1\", \"type\": \"rtmp\", \"listen\": 19357,"
+                           "\"rtmp-server\": {\"ack_window_size\": 10000}}"), ERROR_SUCCESS);
+
+    RsUtestRtmpClient publisher(19357), player(19357);
+    publisher.connect_app("live");
+    player.connect_app("live");
+
+    publisher.start_stream("publish", "ack");
+    publisher.receive_until([&publisher]() { return !publisher.msgs.empty(); });
+    player.start_stream("play", "ack");
+    player.receive_until([&player]() { return player.msgs.size() >= 3; });
+    ASSERT_EQ(player.get_status_code(2), "NetStream.Play.Start");
+    player.msgs.clear();
+
+    // bounded to twice of the window once the player acknowledges
+    send_message(player.fd, player.encoder, rs_rtmp_create_control_message(RS_RTMP_MSG_ACKNOWLEDGEMENT, 0));
+    int rounds = 0;
+    player.receive_until([&rounds]() { return ++rounds > 20; });
+
+    RsRtmpMessage video;
+    video.cs_id = 4;
+    video.type_id = RS_RTMP_MSG_VIDEO;
+    video.stream_id = RS_RTMP_STREAM_ID;
+    std::string payload = std::string("\x27\x01", 2) + std::string(5000, 'v');
+    video.payload = RsSharedSlice::copy_from(payload.data(), payload.size());
+    for (uint32_t i = 0; i < 10; i++) {
+        video.timestamp = i * 40;
+        send_message(publisher.fd, publisher.encoder, video);
+    }
+
+    // stalled on the window
+    player.receive_until([&player]() { return player.msgs.size() >= 4; });
+    rounds = 0;
+    player.receive_until([&rounds]() { return ++rounds > 50; });
+    ASSERT_GE(player.msgs.size(), 4);
+    ASSERT_LT(player.msgs.size(), 10);
+
+    // and resumed by the acknowledgement, nothing more is published
+    send_message(player.fd, player.encoder, rs_rtmp_create_control_message(RS_RTMP_MSG_ACKNOWLEDGEMENT, 1000000));
+    player.receive_until([&player]() { return player.msgs.size() >= 10; });
+    ASSERT_EQ(player.msgs.size(), 10);
+    ASSERT_EQ(player.msgs[9].timestamp, 360);
+}
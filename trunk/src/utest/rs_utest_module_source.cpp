@@ -0,0 +1,385 @@
+/*
+MIT License
+
+Copyright (c) 2016 ME_Kun_Han
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <thread>
+#include "gtest/gtest.h"
+#include "rs_module_source.h"
+
+static RsRtmpMessage create_media_message(uint8_t type_id, uint32_t timestamp, const std::string &payload) {
+    RsRtmpMessage msg;
+    msg.cs_id = 4;
+    msg.timestamp = timestamp;
+    msg.type_id = type_id;
+    msg.stream_id = 1;
+    msg.payload = RsSharedSlice::copy_from(payload.data(), payload.size());
+    return msg;
+}
+
+static RsRtmpMessage create_data_message(const std::string &name) {
+    RsBufferLittleEndian buf;
+    RsAmf0String(name).encode(buf);
+    RsAmf0ECMAArray data;
+    data.encode(buf);
+    RsSlice slice;
+    buf.peek(slice, (int) buf.length());
+    return create_media_message(RS_RTMP_MSG_AMF0_DATA, 0, slice.to_string());
+}
+
+TEST(RsRtmpSourceManager, fetch_or_create) {
+    auto manager = RsRtmpSourceManager::get_instance();
+    ASSERT_EQ(rs_rtmp_get_source_key("live?vhost=a", "stream?token=b"), "live/stream");
+
+    auto source = manager->fetch_or_create("live/utest");
+    ASSERT_EQ(source, manager->fetch_or_create("live/utest"));
+    ASSERT_EQ(source, manager->fetch("live/utest"));
+    ASSERT_TRUE(manager->fetch("live/none") == nullptr);
+
+    // one publisher at a time
+    ASSERT_TRUE(source->on_publish());
+    ASSERT_FALSE(source->on_publish());
+    source->on_unpublish();
+    ASSERT_TRUE(source->on_publish());
+
+    // removed once nobody holds it
+    auto size = manager->size();
+    source.reset();
+    ASSERT_EQ(manager->size(), size - 1);
+    ASSERT_TRUE(manager->fetch("live/utest") == nullptr);
+}
+
+TEST(RsRtmpSource, fan_out) {
+    RsRtmpSource source("live/utest");
+    ASSERT_TRUE(source.on_publish());
+
+    int woken[2] = {0, 0};
+    RsRtmpConsumer first([](void *param) { (*(int *) param)++; }, &woken[0]);
+    RsRtmpConsumer second([](void *param) { (*(int *) param)++; }, &woken[1]);
+    source.attach(&first);
+    source.attach(&second);
+    ASSERT_EQ(source.get_consumer_count(), 2);
+
+    auto video = create_media_message(RS_RTMP_MSG_VIDEO, 40, std::string(6000, 'v'));
+    source.on_message(video);
+    source.on_message(create_media_message(RS_RTMP_MSG_AUDIO, 41, "a"));
+
+    // woken once at the end of the iteration for both messages
+    auto loop = RsLoop::get_instance()->get_uv_loop();
+    uv_run(loop, UV_RUN_NOWAIT);
+    ASSERT_EQ(woken[0], 1);
+    ASSERT_EQ(woken[1], 1);
+
+    // the same message and payload for every consumer
+    std::shared_ptr<RsRtmpSharedMessage> a, b;
+    ASSERT_TRUE(first.dequeue(a));
+    ASSERT_TRUE(second.dequeue(b));
+    ASSERT_EQ(a, b);
+    ASSERT_EQ(a->get_message().payload.data(), video.payload.data());
+    ASSERT_EQ(a->get_message().cs_id, RS_RTMP_CSID_VIDEO);
+    ASSERT_EQ(a->get_message().stream_id, RS_RTMP_STREAM_ID);
+
+    ASSERT_TRUE(first.dequeue(a));
+    ASSERT_EQ(a->get_message().cs_id, RS_RTMP_CSID_AUDIO);
+    ASSERT_FALSE(first.dequeue(a));
+
+    // a publisher on another thread wakes the player by async
+    source.detach(&second);
+    std::thread publisher([&source]() {
+        source.on_message(create_media_message(RS_RTMP_MSG_AUDIO, 42, "a"));
+    });
+    publisher.join();
+
+    for (int i = 0; i < 100 && woken[0] < 2; i++) {
+        uv_run(loop, UV_RUN_NOWAIT);
+        usleep(1000);
+    }
+    ASSERT_EQ(woken[0], 2);
+    ASSERT_EQ(woken[1], 1);
+    ASSERT_EQ(first.size(), 1);
+    ASSERT_EQ(second.size(), 1);
+
+    source.detach(&first);
+}
+
+TEST(RsRtmpSource, gop_cache) {
+    RsRtmpSource source("live/utest");
+    ASSERT_TRUE(source.on_publish());
+    source.set_gop_cache(1000, 100000);
+
+    source.on_message(create_data_message("onMetaData"));
+    source.on_message(create_media_message(RS_RTMP_MSG_VIDEO, 0, std::string("\x17\x00", 2) + "avcc"));
+    source.on_message(create_media_message(RS_RTMP_MSG_AUDIO, 0, std::string("\xaf\x00", 2) + "asc"));
+
+    // nothing before the first keyframe
+    source.on_message(create_media_message(RS_RTMP_MSG_VIDEO, 10, "\x27\x01p"));
+    ASSERT_EQ(source.get_gop_count(), 0);
+
+    source.on_message(create_media_message(RS_RTMP_MSG_VIDEO, 40, "\x17\x01k"));
+    source.on_message(create_media_message(RS_RTMP_MSG_AUDIO, 41, "\xaf\x01" "a"));
+    source.on_message(create_media_message(RS_RTMP_MSG_VIDEO, 80, "\x27\x01p"));
+    ASSERT_EQ(source.get_gop_count(), 3);
+
+    // metadata and sequence headers framed, then the gop at once
+    RsRtmpConsumer consumer(nullptr, nullptr);
+    source.attach(&consumer);
+    ASSERT_EQ(consumer.size(), 3);
+
+    auto frames = consumer.take_start_frames();
+    ASSERT_TRUE(frames != nullptr);
+    ASSERT_EQ(frames->messages.size(), 3);
+    ASSERT_TRUE(consumer.take_start_frames() == nullptr);
+
+    std::vector<uint32_t> timestamps;
+    std::shared_ptr<RsRtmpSharedMessage> msg;
+    while (consumer.dequeue(msg)) {
+        timestamps.push_back(msg->get_message().timestamp);
+    }
+    ASSERT_EQ(timestamps, std::vector<uint32_t>({40, 41, 80}));
+    source.detach(&consumer);
+
+    // a new gop replaces the last one
+    source.on_message(create_media_message(RS_RTMP_MSG_VIDEO, 120, "\x17\x01k"));
+    ASSERT_EQ(source.get_gop_count(), 1);
+
+    // dropped when too long, until the next keyframe
+    source.on_message(create_media_message(RS_RTMP_MSG_VIDEO, 1200, "\x27\x01p"));
+    ASSERT_EQ(source.get_gop_count(), 0);
+    source.on_message(create_media_message(RS_RTMP_MSG_VIDEO, 1240, "\x27\x01p"));
+    ASSERT_EQ(source.get_gop_count(), 0);
+    source.on_message(create_media_message(RS_RTMP_MSG_VIDEO, 1280, "\x17\x01k"));
+    ASSERT_EQ(source.get_gop_count(), 1);
+
+    // or too big
+    source.on_message(create_media_message(RS_RTMP_MSG_VIDEO, 1320, std::string(100000, 'p')));
+    ASSERT_EQ(source.get_gop_count(), 0);
+
+    // all dropped by unpublish
+    source.on_message(create_media_message(RS_RTMP_MSG_VIDEO, 1360, "\x17\x01k"));
+    source.on_unpublish();
+    RsRtmpConsumer late(nullptr, nullptr);
+    source.attach(&late);
+    ASSERT_EQ(late.size(), 0);
+    ASSERT_TRUE(late.take_start_frames() == nullptr);
+    source.detach(&late);
+
+    uv_run(RsLoop::get_instance()->get_uv_loop(), UV_RUN_NOWAIT);
+}
+
+TEST(RsRtmpSource, start_frames) {
+    RsRtmpSource source("live/utest");
+    ASSERT_TRUE(source.on_publish());
+    source.set_frame_chunk_size(128);
+
+    // @setDataFrame is removed by slicing
+    RsBufferLittleEndian buf;
+    RsAmf0String("@setDataFrame").encode(buf);
+    RsAmf0String("onMetaData").encode(buf);
+    RsAmf0ECMAArray meta;
+    meta.set("title", new RsAmf0String(std::string(200, 't')));
+    meta.encode(buf);
+    RsSlice slice;
+    buf.peek(slice, (int) buf.length());
+    auto metadata = create_media_message(RS_RTMP_MSG_AMF0_DATA, 0, slice.to_string());
+
+    source.on_message(metadata);
+    source.on_message(create_media_message(RS_RTMP_MSG_VIDEO, 0, std::string("\x17\x00", 2) + std::string(300, 'c')));
+
+    RsRtmpConsumer consumer(nullptr, nullptr);
+    source.attach(&consumer);
+    auto frames = consumer.take_start_frames();
+    ASSERT_TRUE(frames != nullptr);
+    ASSERT_EQ(frames->chunk_size, 128);
+    ASSERT_EQ(frames->messages.size(), 2);
+    auto &m = frames->messages[0]->get_message();
+    ASSERT_EQ(m.payload.data(), metadata.payload.data() + 16);
+    ASSERT_EQ(m.payload.size(), metadata.payload.size() - 16);
+
+    // the frames decode to the messages sent by an encoder of same chunk size
+    std::vector<RsRtmpMessage> msgs;
+    RsRtmpChunkMsgAsync decoder;
+    decoder.set_message_cb([&msgs](RsRtmpMessage &msg, void *) {
+        msgs.push_back(msg);
+        return ERROR_SUCCESS;
+    }, nullptr);
+    ASSERT_EQ(decoder.on_msg(frames->frames.data(), frames->frames.size()), ERROR_SUCCESS);
+
+    // and the encoder of a player follows with smaller headers
+    RsRtmpChunkEncoder encoder;
+    for (auto &msg : frames->messages) {
+        encoder.on_framed(msg->get_message());
+    }
+    auto video = create_media_message(RS_RTMP_MSG_VIDEO, 40, std::string("\x17\x01", 2) + "k");
+    video.cs_id = RS_RTMP_CSID_VIDEO;
+    std::vector<RsSharedSlice> slices;
+    encoder.encode(video, slices);
+    ASSERT_EQ(slices[0].size(), 8);
+    for (auto &s : slices) {
+        ASSERT_EQ(decoder.on_msg(s.data(), s.size()), ERROR_SUCCESS);
+    }
+
+    ASSERT_EQ(msgs.size(), 3);
+    ASSERT_EQ(msgs[0].type_id, RS_RTMP_MSG_AMF0_DATA);
+    ASSERT_EQ(msgs[0].payload.view().to_string(), m.payload.view().to_string());
+    ASSERT_EQ(msgs[1].cs_id, RS_RTMP_CSID_VIDEO);
+    ASSERT_EQ(msgs[1].payload.size(), 302);
+    ASSERT_EQ(msgs[2].timestamp, 40);
+
+    source.detach(&consumer);
+    uv_run(RsLoop::get_instance()->get_uv_loop(), UV_RUN_NOWAIT);
+}
+
+TEST(RsRtmpSource, metadata) {
+    RsRtmpSource source("live/utest");
+    ASSERT_TRUE(source.on_publish());
+
+    // a cue point is not cached as the metadata
+    source.on_message(create_data_message("onMetaData"));
+    source.on_message(create_data_message("onCuePoint"));
+    ASSERT_EQ(rs_rtmp_get_data_name(create_data_message("onCuePoint")), "onCuePoint");
+
+    RsRtmpConsumer consumer(nullptr, nullptr);
+    source.attach(&consumer);
+    auto frames = consumer.take_start_frames();
+    ASSERT_TRUE(frames != nullptr);
+    ASSERT_EQ(frames->messages.size(), 1);
+    ASSERT_EQ(rs_rtmp_get_data_name(frames->messages[0]->get_message()), "onMetaData");
+
+    source.detach(&consumer);
+    uv_run(RsLoop::get_instance()->get_uv_loop(), UV_RUN_NOWAIT);
+}
+
+TEST(RsRtmpConsumer, wakeup) {
+    auto loop = RsLoop::get_instance()->get_uv_loop();
+
+    int woken = 0;
+    RsRtmpConsumer consumer([](void *param) { (*(int *) param)++; }, &woken);
+
+    auto msg = std::make_shared<RsRtmpSharedMessage>(create_media_message(RS_RTMP_MSG_AUDIO, 0, "a"));
+    std::shared_ptr<RsRtmpSharedMessage> out;
+
+    consumer.enqueue(msg);
+    uv_run(loop, UV_RUN_NOWAIT);
+    ASSERT_EQ(woken, 1);
+
+    // not drained as the player is not writable, the pushes do not wake it up again
+    for (int i = 0; i < 3; i++) {
+        consumer.enqueue(msg);
+        uv_run(loop, UV_RUN_NOWAIT);
+    }
+    ASSERT_EQ(woken, 1);
+    ASSERT_TRUE(consumer.dequeue(out));
+
+    // until drained
+    while (consumer.dequeue(out)) {
+    }
+    consumer.enqueue(msg);
+    uv_run(loop, UV_RUN_NOWAIT);
+    ASSERT_EQ(woken, 2);
+}
+
+TEST(RsRtmpConsumer, merged_write) {
+    auto loop = RsLoop::get_instance()->get_uv_loop();
+    auto run_until = [loop](std::function<bool()> done) {
+        for (int i = 0; i < 200 && !done(); i++) {
+            uv_run(loop, UV_RUN_NOWAIT);
+            usleep(1000);
+        }
+    };
+
+    int woken = 0;
+    RsRtmpConsumer consumer([](void *param) { (*(int *) param)++; }, &woken);
+    consumer.set_merged_write(100, 3);
+
+    auto msg = std::make_shared<RsRtmpSharedMessage>(create_media_message(RS_RTMP_MSG_AUDIO, 0, "a"));
+    std::shared_ptr<RsRtmpSharedMessage> out;
+
+    // woken by the messages in the window
+    consumer.enqueue(msg);
+    consumer.enqueue(msg);
+    uv_run(loop, UV_RUN_NOWAIT);
+    ASSERT_EQ(woken, 0);
+    consumer.enqueue(msg);
+    uv_run(loop, UV_RUN_NOWAIT);
+    ASSERT_EQ(woken, 1);
+    while (consumer.dequeue(out)) {
+    }
+
+    // or by the window
+    auto start = rs_get_system_time_ms();
+    consumer.enqueue(msg);
+    run_until([&woken]() { return woken == 2; });
+    ASSERT_EQ(woken, 2);
+    ASSERT_GE(rs_get_system_time_ms() - start, 90);
+    while (consumer.dequeue(out)) {
+    }
+
+    // the start frames are not delayed
+    consumer.set_start_frames(std::make_shared<RsRtmpStartFrames>());
+    consumer.enqueue(msg);
+    uv_run(loop, UV_RUN_NOWAIT);
+    ASSERT_EQ(woken, 3);
+}
+
+TEST(RsRtmpConsumer, congestion) {
+    RsRtmpConsumer consumer(nullptr, nullptr, 4);
+    ASSERT_EQ(consumer.size(), 0);
+
+    auto keyframe = std::make_shared<RsRtmpSharedMessage>(
+            create_media_message(RS_RTMP_MSG_VIDEO, 0, std::string("\x17\x01", 2)));
+    auto inter = std::make_shared<RsRtmpSharedMessage>(
+            create_media_message(RS_RTMP_MSG_VIDEO, 40, std::string("\x27\x01", 2)));
+    auto audio = std::make_shared<RsRtmpSharedMessage>(create_media_message(RS_RTMP_MSG_AUDIO, 41, "a"));
+    std::shared_ptr<RsRtmpSharedMessage> out;
+
+    consumer.enqueue(keyframe);
+    for (int i = 0; i < 3; i++) {
+        consumer.enqueue(inter);
+    }
+    ASSERT_EQ(consumer.size(), 4);
+    ASSERT_EQ(consumer.get_dropped_count(), 0);
+
+    // full, dropped until next keyframe
+    consumer.enqueue(inter);
+    ASSERT_EQ(consumer.get_dropped_count(), 1);
+    ASSERT_TRUE(consumer.dequeue(out));
+    ASSERT_TRUE(consumer.dequeue(out));
+    consumer.enqueue(inter);
+    ASSERT_EQ(consumer.get_dropped_count(), 2);
+    ASSERT_EQ(consumer.size(), 2);
+
+    // audio once half of the ring is drained
+    consumer.enqueue(audio);
+    ASSERT_EQ(consumer.size(), 3);
+    consumer.enqueue(audio);
+    ASSERT_EQ(consumer.get_dropped_count(), 3);
+
+    consumer.enqueue(keyframe);
+    consumer.enqueue(inter);
+    ASSERT_EQ(consumer.get_dropped_count(), 4);
+    while (consumer.dequeue(out)) {
+    }
+    consumer.enqueue(keyframe);
+    consumer.enqueue(inter);
+    ASSERT_EQ(consumer.size(), 2);
+    ASSERT_EQ(consumer.get_dropped_count(), 4);
+}
@@ -24,6 +24,8 @@ SOFTWARE.
 
 #include "rs_protocol_rtmp.h"
 #include "rs_kernel_buffer.h"
+#include "rs_kernel_sha256.h"
+#include <chrono>
 #include "gtest/gtest.h"
 
 using namespace std;
@@ -153,4 +155,523 @@ TEST(RTMP_CHUNK_MESSAGE, create_msgs) {
         ASSERT_EQ(4, test.size());
         test.clear();
     }
-}
\ No newline at end of file
+}
+
+// basic header of fmt and cs_id, 1 to 3 bytes
+static void encode_basic_header(string &out, uint8_t fmt, uint32_t cs_id) {
+    if (cs_id < 64) {
+        out.push_back(char((fmt << 6) | cs_id));
+    } else if (cs_id < 320) {
+        out.push_back(char(fmt << 6));
+        out.push_back(char(cs_id - 64));
+    } else {
+        out.push_back(char((fmt << 6) | 1));
+        out.push_back(char((cs_id - 64) & 0xff));
+        out.push_back(char((cs_id - 64) >> 8));
+    }
+}
+
+// one message in chunks, the first chunk of fmt with the timestamp field, type 3 for the rest
+static void encode_message(string &out, uint8_t fmt, uint32_t cs_id, uint32_t ts_field,
+                           uint8_t type_id, uint32_t stream_id, const string &payload,
+                           uint32_t chunk_size) {
+    bool extended = ts_field >= 0xffffff;
+    char header[11];
+    rs_write_be24(header, extended ? 0xffffff : ts_field);
+    rs_write_be24(header + 3, (uint32_t) payload.size());
+    header[6] = char(type_id);
+    rs_write_le32(header + 7, stream_id);
+
+    static const size_t sizes[] = {11, 7, 3, 0};
+    size_t pos = 0;
+    do {
+        encode_basic_header(out, pos == 0 ? fmt : uint8_t(3), cs_id);
+        if (pos == 0) {
+            out.append(header, sizes[fmt]);
+        }
+        if (extended) {
+            char ext[4];
+            rs_write_be<uint32_t>(ext, ts_field);
+            out.append(ext, 4);
+        }
+        auto n = std::min((size_t) chunk_size, payload.size() - pos);
+        out.append(payload, pos, n);
+        pos += n;
+    } while (pos < payload.size());
+}
+
+static int collect_message(RsRtmpMessage &msg, void *param) {
+    ((vector<RsRtmpMessage> *) param)->push_back(msg);
+    return ERROR_SUCCESS;
+}
+
+TEST(RsRtmpChunkMsgAsync, fragmented) {
+    string a = rs_get_random(300), b = rs_get_random(200), c = rs_get_random(100);
+    string stream;
+
+    // interleave two messages on cs_id 3 and 400 with chunk size 128
+    string a_chunks, b_chunks;
+    encode_message(a_chunks, 0, 3, 1000, 9, 1, a, 128);
+    encode_message(b_chunks, 0, 400, 0x1000000, 8, 1, b, 128);
+    stream.append(a_chunks, 0, 1 + 11 + 128);
+    stream.append(b_chunks, 0, 3 + 11 + 4 + 128);
+    stream.append(a_chunks, 1 + 11 + 128, string::npos);
+    stream.append(b_chunks, 3 + 11 + 4 + 128, string::npos);
+    // a delta of 40 by type 1, then type 3 repeats it, an empty message by type 2
+    encode_message(stream, 1, 3, 40, 9, 0, c, 128);
+    encode_message(stream, 3, 3, 0, 0, 0, c, 128);
+    encode_message(stream, 2, 70, 0, 0, 0, string(), 128);
+
+    // the cs_id 70 has no previous header
+    {
+        RsRtmpChunkMsgAsync decoder;
+        vector<RsRtmpMessage> msgs;
+        decoder.set_message_cb(collect_message, &msgs);
+        ASSERT_EQ(ERROR_RTMP_PROTOCOL_CHUNK_STREAM_NO_HEADER, decoder.on_msg(stream.data(), stream.size()));
+        ASSERT_EQ(4, msgs.size());
+    }
+
+    string prefix;
+    encode_message(prefix, 0, 70, 5, 20, 0, string(), 128);
+    stream = prefix + stream;
+
+    for (size_t step : {stream.size(), (size_t) 1, (size_t) 7}) {
+        RsRtmpChunkMsgAsync decoder;
+        vector<RsRtmpMessage> msgs;
+        decoder.set_message_cb(collect_message, &msgs);
+
+        for (size_t pos = 0; pos < stream.size(); pos += step) {
+            auto n = std::min(step, stream.size() - pos);
+            ASSERT_EQ(ERROR_SUCCESS, decoder.on_msg(stream.data() + pos, n));
+        }
+
+        ASSERT_EQ(6, msgs.size());
+        ASSERT_EQ(70, msgs[0].cs_id);
+        ASSERT_EQ(20, msgs[0].type_id);
+        ASSERT_TRUE(msgs[0].payload.empty());
+
+        ASSERT_EQ(3, msgs[1].cs_id);
+        ASSERT_EQ(1000, msgs[1].timestamp);
+        ASSERT_EQ(9, msgs[1].type_id);
+        ASSERT_EQ(1, msgs[1].stream_id);
+        ASSERT_EQ(a, msgs[1].payload.view().to_string());
+
+        ASSERT_EQ(400, msgs[2].cs_id);
+        ASSERT_EQ(0x1000000, msgs[2].timestamp);
+        ASSERT_EQ(8, msgs[2].type_id);
+        ASSERT_EQ(b, msgs[2].payload.view().to_string());
+
+        ASSERT_EQ(1040, msgs[3].timestamp);
+        ASSERT_EQ(1, msgs[3].stream_id);
+        ASSERT_EQ(c, msgs[3].payload.view().to_string());
+        ASSERT_EQ(1080, msgs[4].timestamp);
+        ASSERT_EQ(c, msgs[4].payload.view().to_string());
+
+        ASSERT_EQ(70, msgs[5].cs_id);
+        ASSERT_EQ(5, msgs[5].timestamp);
+        ASSERT_TRUE(msgs[5].payload.empty());
+    }
+}
+
+TEST(RsRtmpChunkMsgAsync, interrupted) {
+    string stream;
+    encode_message(stream, 0, 3, 0, 9, 1, rs_get_random(300), 128);
+    // a new header before the message completed
+    string first(stream, 0, 1 + 11 + 128);
+    encode_message(first, 0, 3, 0, 9, 1, rs_get_random(10), 128);
+
+    RsRtmpChunkMsgAsync decoder;
+    ASSERT_EQ(ERROR_RTMP_PROTOCOL_CHUNK_INTERRUPTED, decoder.on_msg(first.data(), first.size()));
+}
+
+TEST(RsRtmpChunkMsgAsync, chunk_stream_table) {
+    // messages of 3 chunks on cs_id from 2 to 999, the chunks of all streams interleaved
+    vector<string> payloads, chunks;
+    for (uint32_t cs_id = 2; cs_id < 1000; cs_id++) {
+        payloads.push_back(rs_get_random(300));
+        string out;
+        encode_message(out, 0, cs_id, cs_id, 9, 1, payloads.back(), 128);
+        encode_message(out, 3, cs_id, 0, 0, 0, payloads.back(), 128);
+        chunks.push_back(out);
+    }
+
+    string stream;
+    vector<size_t> pos(chunks.size(), 0);
+    for (int round = 0; round < 6; round++) {
+        for (size_t i = 0; i < chunks.size(); i++) {
+            uint32_t cs_id = i + 2;
+            size_t basic_size = cs_id < 64 ? 1 : (cs_id < 320 ? 2 : 3);
+            size_t header_size = (round == 0 ? 11 : 0) + basic_size;
+            size_t n = header_size + (round % 3 == 2 ? 300 - 256 : 128);
+            stream.append(chunks[i], pos[i], n);
+            pos[i] += n;
+        }
+    }
+
+    RsRtmpChunkMsgAsync decoder;
+    vector<RsRtmpMessage> msgs;
+    decoder.set_message_cb(collect_message, &msgs);
+    ASSERT_EQ(ERROR_SUCCESS, decoder.on_msg(stream.data(), stream.size()));
+
+    ASSERT_EQ(2 * payloads.size(), msgs.size());
+    for (size_t i = 0; i < msgs.size(); i++) {
+        auto index = i % payloads.size();
+        ASSERT_EQ(index + 2, msgs[i].cs_id);
+        ASSERT_EQ(i < payloads.size() ? index + 2 : 2 * (index + 2), msgs[i].timestamp);
+        ASSERT_EQ(payloads[index], msgs[i].payload.view().to_string());
+    }
+}
+
+TEST(RsRtmpChunkMsgAsync, max_message_size) {
+    string stream;
+    encode_message(stream, 0, 3, 0, 9, 1, rs_get_random(300), 128);
+
+    RsRtmpChunkMsgAsync decoder;
+    vector<RsRtmpMessage> msgs;
+    decoder.set_message_cb(collect_message, &msgs);
+    decoder.set_max_message_size(300);
+    ASSERT_EQ(ERROR_SUCCESS, decoder.on_msg(stream.data(), stream.size()));
+    ASSERT_EQ(1, msgs.size());
+
+    decoder.set_max_message_size(299);
+    ASSERT_EQ(ERROR_RTMP_PROTOCOL_MESSAGE_TOO_LARGE, decoder.on_msg(stream.data(), stream.size()));
+    ASSERT_EQ(1, msgs.size());
+}
+
+static int count_message(RsRtmpMessage &msg, void *param) {
+    *(uint64_t *) param += msg.payload.size();
+    return ERROR_SUCCESS;
+}
+
+TEST(RsRtmpChunkMsgAsync, throughput) {
+    const uint32_t chunk_size = 4096;
+    string payload = rs_get_random(64 * 1024);
+
+    string stream;
+    encode_message(stream, 0, 6, 0, 9, 1, payload, chunk_size);
+    for (int i = 0; i < 15; i++) {
+        encode_message(stream, 3, 6, 0, 0, 0, payload, chunk_size);
+    }
+
+    RsRtmpChunkMsgAsync decoder;
+    uint64_t bytes = 0;
+    decoder.set_chunk_size(chunk_size);
+    decoder.set_message_cb(count_message, &bytes);
+
+    // 256MB fed in reads of 64KB
+    const int rounds = 256;
+    const size_t read_size = 64 * 1024;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++) {
+        for (size_t pos = 0; pos < stream.size(); pos += read_size) {
+            auto n = std::min(read_size, stream.size() - pos);
+            ASSERT_EQ(ERROR_SUCCESS, decoder.on_msg(stream.data() + pos, n));
+        }
+    }
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    ASSERT_EQ((uint64_t) rounds * 16 * payload.size(), bytes);
+    printf("decoded %.1fMB of chunks in %.3fs, %.2fGB/s\n", stream.size() * rounds / 1e6, elapsed,
+           stream.size() * rounds / elapsed / 1e9);
+}
+
+TEST(RsRtmpChunkEncoder, encode) {
+    RsRtmpMessage msg;
+    msg.cs_id = 6;
+    msg.type_id = 9;
+    msg.stream_id = 1;
+    msg.payload = RsSharedSlice::copy_from(rs_get_random(1000).data(), 1000);
+
+    for (uint32_t timestamp : {(uint32_t) 1000, (uint32_t) 0x1000000}) {
+        for (uint32_t chunk_size : {(uint32_t) 128, (uint32_t) 1000, (uint32_t) 4096}) {
+            msg.timestamp = timestamp;
+
+            RsRtmpChunkEncoder encoder;
+            encoder.set_chunk_size(chunk_size);
+            vector<RsSharedSlice> slices;
+            auto bytes = encoder.encode(msg, slices);
+
+            // the payload slices point into the message, no copy
+            string stream;
+            for (size_t i = 0; i < slices.size(); i++) {
+                if (i % 2 == 1) {
+                    ASSERT_TRUE(slices[i].data() >= msg.payload.data());
+                    ASSERT_TRUE(slices[i].data() < msg.payload.data() + msg.payload.size());
+                }
+                stream.append(slices[i].data(), slices[i].size());
+            }
+            ASSERT_EQ(bytes, stream.size());
+
+            string expected;
+            encode_message(expected, 0, 6, timestamp, 9, 1, msg.payload.view().to_string(), chunk_size);
+            ASSERT_EQ(expected, stream);
+
+            RsRtmpChunkMsgAsync decoder;
+            vector<RsRtmpMessage> msgs;
+            decoder.set_chunk_size(chunk_size);
+            decoder.set_message_cb(collect_message, &msgs);
+            ASSERT_EQ(ERROR_SUCCESS, decoder.on_msg(stream.data(), stream.size()));
+            ASSERT_EQ(1, msgs.size());
+            ASSERT_EQ(timestamp, msgs[0].timestamp);
+            ASSERT_EQ(msg.payload.view().to_string(), msgs[0].payload.view().to_string());
+        }
+    }
+
+    // an empty message is one header
+    msg.timestamp = 0;
+    msg.payload = RsSharedSlice();
+    RsRtmpChunkEncoder encoder;
+    vector<RsSharedSlice> slices;
+    ASSERT_EQ(12, encoder.encode(msg, slices));
+    ASSERT_EQ(1, slices.size());
+}
+
+TEST(RsRtmpChunkEncoder, shared_message) {
+    RsRtmpMessage raw;
+    raw.cs_id = 6;
+    raw.timestamp = 40;
+    raw.type_id = 9;
+    raw.stream_id = 1;
+    raw.payload = RsSharedSlice::copy_from(rs_get_random(1000).data(), 1000);
+    RsRtmpSharedMessage msg(raw);
+
+    RsRtmpChunkEncoder a, b, c;
+    c.set_chunk_size(4096);
+
+    vector<RsSharedSlice> slices_a, slices_b, slices_c, expected;
+    auto bytes = a.encode(msg, slices_a);
+    ASSERT_EQ(bytes, b.encode(msg, slices_b));
+    ASSERT_EQ(bytes, RsRtmpChunkEncoder().encode(raw, expected));
+    c.encode(msg, slices_c);
+
+    // the body is encoded once for each chunk size
+    ASSERT_EQ(expected.size(), slices_a.size());
+    ASSERT_EQ(2, slices_c.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+        ASSERT_EQ(expected[i].view().to_string(), slices_a[i].view().to_string());
+        if (i > 0) {
+            ASSERT_EQ(slices_a[i].data(), slices_b[i].data());
+        }
+    }
+    ASSERT_EQ(slices_c[1].data(), raw.payload.data());
+
+    // framed by the producer, every encoder of that chunk size sends the same chunks
+    RsRtmpSharedMessage framed(raw);
+    auto pool = std::make_shared<RsBufferPool>();
+    framed.frame(4096, pool.get());
+    ASSERT_EQ(framed.get_body(4096, false, pool.get()), framed.get_body(4096, false, pool.get()));
+    ASSERT_NE(framed.get_body(128, false, pool.get()), framed.get_body(4096, false, pool.get()));
+    ASSERT_EQ(framed.get_body(4096, false, pool.get())->bytes, 1000);
+}
+
+TEST(RsRtmpChunkEncoder, minimal_fmt) {
+    struct {
+        uint32_t timestamp;
+        uint32_t length;
+        uint8_t type_id;
+        uint32_t stream_id;
+        uint8_t fmt;
+    } cases[] = {
+            {0, 10, 8, 1, 0},
+            {23, 10, 8, 1, 2},
+            {46, 10, 8, 1, 3},
+            {69, 10, 8, 1, 3},
+            {93, 10, 8, 1, 2},
+            {116, 12, 8, 1, 1},
+            {139, 12, 8, 1, 3},
+            {130, 12, 8, 1, 0},
+            {150, 300, 8, 2, 0},
+            {0x1000000, 300, 8, 2, 2},
+            {0x1000010, 300, 8, 2, 2},
+            {0x1000020, 300, 8, 2, 3},
+            {0x3000020, 300, 8, 2, 0},
+            {0x3000030, 300, 8, 2, 2},
+    };
+
+    RsRtmpChunkEncoder encoder;
+    RsRtmpChunkMsgAsync decoder;
+    vector<RsRtmpMessage> msgs;
+    decoder.set_message_cb(collect_message, &msgs);
+
+    for (auto &c : cases) {
+        RsRtmpMessage msg;
+        msg.cs_id = 4;
+        msg.timestamp = c.timestamp;
+        msg.type_id = c.type_id;
+        msg.stream_id = c.stream_id;
+        msg.payload = RsSharedSlice::copy_from(rs_get_random(c.length).data(), c.length);
+
+        // the first header alternates with shared and not shared messages
+        vector<RsSharedSlice> slices;
+        if (c.timestamp % 2) {
+            RsRtmpSharedMessage shared(msg);
+            encoder.encode(shared, slices);
+        } else {
+            encoder.encode(msg, slices);
+        }
+        ASSERT_EQ(c.fmt, ((uint8_t) slices[0].data()[0]) >> 6);
+
+        string stream;
+        for (auto &slice : slices) {
+            stream.append(slice.data(), slice.size());
+        }
+        ASSERT_EQ(ERROR_SUCCESS, decoder.on_msg(stream.data(), stream.size()));
+        ASSERT_EQ(1, msgs.size());
+        ASSERT_EQ(c.timestamp, msgs[0].timestamp);
+        ASSERT_EQ(c.type_id, msgs[0].type_id);
+        ASSERT_EQ(c.stream_id, msgs[0].stream_id);
+        ASSERT_EQ(msg.payload.view().to_string(), msgs[0].payload.view().to_string());
+        msgs.clear();
+    }
+}
+
+TEST(RtmpHandshakeAsync, fragmented) {
+    string c0c1 = "\x03" + rs_get_random(1536);
+    string c2 = rs_get_random(1536);
+    string chunks = rs_get_random(100);
+    string stream = c0c1 + c2 + chunks;
+
+    for (size_t step : {stream.size(), (size_t) 1, (size_t) 1000}) {
+        RtmpHandshakeAsync handshake;
+        string reply, left;
+        handshake.set_callbacks([&reply](const RsSharedSlice &s0s1s2, void *) {
+            reply = s0s1s2.view().to_string();
+            return ERROR_SUCCESS;
+        }, [&left](const char *buf, size_t size, void *) {
+            left.assign(buf, size);
+            return ERROR_SUCCESS;
+        }, nullptr);
+
+        for (size_t pos = 0; pos < stream.size() && !handshake.is_completed(); pos += step) {
+            auto n = std::min(step, stream.size() - pos);
+            ASSERT_EQ(ERROR_SUCCESS, handshake.on_msg(stream.data() + pos, n));
+
+            // s0s1s2 once c0c1 is complete
+            ASSERT_EQ(pos + n >= 1537, reply.size() == 3073);
+        }
+
+        ASSERT_TRUE(handshake.is_completed());
+        ASSERT_EQ(3, reply[0]);
+        // s2 echoes the time and random of c1
+        ASSERT_EQ(c0c1.substr(1, 4), reply.substr(1537, 4));
+        ASSERT_EQ(c0c1.substr(9), reply.substr(1537 + 8));
+        // the rest of the read where c2 completed
+        ASSERT_EQ(step == 1 ? string() : chunks, left);
+    }
+
+    RtmpHandshakeAsync handshake;
+    string c0c1_v6 = "\x06" + rs_get_random(1536);
+    ASSERT_EQ(ERROR_RTMP_PROTOCOL_VERSION_ERROR, handshake.on_msg(c0c1_v6.data(), c0c1_v6.size()));
+}
+
+static const uint8_t genuine_key_tail[] = {
+        0xf0, 0xee, 0xc2, 0x4a, 0x80, 0x68, 0xbe, 0xe8, 0x2e, 0x00, 0xd0, 0xd1, 0x02, 0x9e, 0x7e, 0x57,
+        0x6e, 0xec, 0x5d, 0x2d, 0x29, 0x80, 0x6f, 0xab, 0x93, 0xb8, 0xe6, 0x36, 0xcf, 0xeb, 0x31, 0xae
+};
+
+static size_t get_digest_offset(const string &c1, size_t base) {
+    auto b = (const uint8_t *) c1.data() + base;
+    return (b[0] + b[1] + b[2] + b[3]) % 728 + base + 4;
+}
+
+static string sign_digest(const string &key, const string &data, size_t offset) {
+    uint8_t digest[RS_SHA256_DIGEST_SIZE];
+    RsSlice parts[2] = {RsSlice(data.data(), offset), RsSlice(data.data() + offset + 32, data.size() - offset - 32)};
+    RsHmacSha256(key.data(), key.size()).sign(parts, 2, digest);
+    return string((char *) digest, sizeof(digest));
+}
+
+// c0c1 of a flash player, with the digest block at base
+static string create_signed_c0c1(size_t base) {
+    string c1 = rs_get_random(1536);
+    rs_write_be<uint32_t>(&c1[4], 0x80000702);
+    auto offset = get_digest_offset(c1, base);
+    c1.replace(offset, 32, sign_digest("Genuine Adobe Flash Player 001", c1, offset));
+    return "\x03" + c1;
+}
+
+TEST(RtmpHandshakeAsync, complex) {
+    string fms_key = "Genuine Adobe Flash Media Server 001";
+
+    for (size_t base : {(size_t) 8, (size_t) 772}) {
+        string c0c1 = create_signed_c0c1(base);
+
+        RtmpHandshakeAsync handshake;
+        string reply;
+        handshake.set_callbacks([&reply](const RsSharedSlice &s0s1s2, void *) {
+            reply = s0s1s2.view().to_string();
+            return ERROR_SUCCESS;
+        }, nullptr, nullptr);
+        ASSERT_EQ(ERROR_SUCCESS, handshake.on_msg(c0c1.data(), c0c1.size()));
+        ASSERT_EQ(3073u, reply.size());
+
+        // s1 is signed by the server key in the schema of c1
+        string s1 = reply.substr(1, 1536);
+        ASSERT_NE(0u, rs_read_be<uint32_t>(s1.data() + 4));
+        auto offset = get_digest_offset(s1, base);
+        ASSERT_EQ(sign_digest(fms_key, s1, offset), s1.substr(offset, 32));
+
+        // s2 ends with the digest by the key from the digest of c1
+        string full_key = fms_key + string((const char *) genuine_key_tail, 32);
+        uint8_t key[RS_SHA256_DIGEST_SIZE], digest[RS_SHA256_DIGEST_SIZE];
+        auto c1_offset = get_digest_offset(c0c1.substr(1), base) + 1;
+        RsHmacSha256(full_key.data(), full_key.size()).sign(c0c1.data() + c1_offset, 32, key);
+        string s2 = reply.substr(1537);
+        RsHmacSha256(key, sizeof(key)).sign(s2.data(), 1504, digest);
+        ASSERT_EQ(string((char *) digest, 32), s2.substr(1504));
+    }
+
+    // the random bytes of s1 and s2 are new for every handshake
+    string randoms[2][2];
+    string c0c1_signed = create_signed_c0c1(772);
+    for (auto &random : randoms) {
+        RtmpHandshakeAsync handshake;
+        string reply;
+        handshake.set_callbacks([&reply](const RsSharedSlice &s0s1s2, void *) {
+            reply = s0s1s2.view().to_string();
+            return ERROR_SUCCESS;
+        }, nullptr, nullptr);
+        ASSERT_EQ(ERROR_SUCCESS, handshake.on_msg(c0c1_signed.data(), c0c1_signed.size()));
+        random[0] = reply.substr(1 + 8, 764);
+        random[1] = reply.substr(1537, 1504);
+    }
+    ASSERT_NE(randoms[0][0], randoms[1][0]);
+    ASSERT_NE(randoms[0][1], randoms[1][1]);
+    ASSERT_NE(randoms[0][1].substr(0, 764), randoms[0][0]);
+
+    // a bad digest falls back to the simple handshake
+    string c0c1 = create_signed_c0c1(8);
+    c0c1[get_digest_offset(c0c1.substr(1), 8) + 1] ^= 0xff;
+
+    RtmpHandshakeAsync handshake;
+    string reply;
+    handshake.set_callbacks([&reply](const RsSharedSlice &s0s1s2, void *) {
+        reply = s0s1s2.view().to_string();
+        return ERROR_SUCCESS;
+    }, nullptr, nullptr);
+    ASSERT_EQ(ERROR_SUCCESS, handshake.on_msg(c0c1.data(), c0c1.size()));
+    ASSERT_EQ(0u, rs_read_be<uint32_t>(reply.data() + 5));
+    ASSERT_EQ(c0c1.substr(9), reply.substr(1537 + 8));
+}
+
+TEST(RtmpHandshakeAsync, complex_throughput) {
+    string c0c1 = create_signed_c0c1(772);
+    int count = 0;
+    auto reply_cb = [&count](const RsSharedSlice &, void *) {
+        count++;
+        return ERROR_SUCCESS;
+    };
+
+    const int rounds = 2000;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++) {
+        RtmpHandshakeAsync handshake;
+        handshake.set_callbacks(reply_cb, nullptr, nullptr);
+        ASSERT_EQ(ERROR_SUCCESS, handshake.on_msg(c0c1.data(), c0c1.size()));
+    }
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    ASSERT_EQ(rounds, count);
+    printf("%d complex handshakes in %.3fs, %.0f handshakes/s on one core\n", rounds, elapsed,
+           rounds / elapsed);
+}